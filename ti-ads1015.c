@@ -24,6 +24,20 @@
 #include <linux/mutex.h>
 #include <linux/delay.h>
 #include <linux/interrupt.h>
+#include <linux/completion.h>
+#include <linux/workqueue.h>
+#include <linux/hrtimer.h>
+#include <linux/sched.h>
+#include <linux/cpumask.h>
+#include <linux/spinlock.h>
+#include <linux/wait.h>
+#include <linux/atomic.h>
+#include <linux/slab.h>
+#include <linux/mm.h>
+#include <linux/vmalloc.h>
+#include <linux/version.h>
+#include <linux/uaccess.h>
+#include <uapi/linux/sched/types.h>
 
 #include <linux/platform_data/ads1015.h>
 
@@ -31,7 +45,10 @@
 #include <linux/iio/types.h>
 #include <linux/iio/sysfs.h>
 #include <linux/iio/buffer.h>
-#include <linux/iio/kfifo_buf.h>
+#include <linux/iio/buffer_impl.h>
+#include <linux/iio/trigger.h>
+#include <linux/iio/trigger_consumer.h>
+#include <linux/iio/triggered_buffer.h>
 
 #define ADS1015_DRV_NAME "ads1015"
 #define ADS1015_IRQ_NAME "ads1015_rdy"
@@ -49,6 +66,7 @@
 #define ADS1015_CFG_MOD_SHIFT 8
 #define ADS1015_CFG_PGA_SHIFT 9
 #define ADS1015_CFG_MUX_SHIFT 12
+#define ADS1015_CFG_OS_SHIFT 15
 
 #define ADS1015_CFG_COMP_QUE_MASK GENMASK(1, 0)
 #define ADS1015_CFG_COMP_LAT_MASK BIT(2)
@@ -58,6 +76,7 @@
 #define ADS1015_CFG_MOD_MASK BIT(8)
 #define ADS1015_CFG_PGA_MASK GENMASK(11, 9)
 #define ADS1015_CFG_MUX_MASK GENMASK(14, 12)
+#define ADS1015_CFG_OS_MASK BIT(15)
 
 /* Comparator queue and disable field */
 #define ADS1015_CFG_COMP_DISABLE 3
@@ -76,15 +95,188 @@
 
 #define ADS1015_SLEEP_DELAY_MS 2000
 #define ADS1015_DEFAULT_PGA 2
+
+/*
+ * Auto-ranging: step to a wider range on a result above 15/16 of full
+ * scale, to a narrower one when the peak of a window of results stays
+ * below 3/8, i.e. still 20% under the upper threshold after the step
+ */
+#define ADS1015_AUTORANGE_HIGH 30720
+#define ADS1015_AUTORANGE_LOW 12288
+#define ADS1015_AUTORANGE_WINDOW 8
+/* narrowest distinct range, PGA 6 and 7 repeat 256 mV */
+#define ADS1015_AUTORANGE_PGA_MAX 5
+
+/* calibscale is applied as a Q20 multiplier, at most 2.0 */
+#define ADS1015_CALIBSCALE_SHIFT 20
+#define ADS1015_CALIBSCALE_ONE 1000000
+#define ADS1015_CALIBSCALE_MAX (2 * ADS1015_CALIBSCALE_ONE)
+
+/* fraction bits of the uV per LSB multipliers */
+#define ADS1015_UV_MULT_SHIFT 16
 #define ADS1015_DEFAULT_DATA_RATE 4
 #define ADS1015_DEFAULT_CHAN 0
 
+/* bus recovery back-off, doubled after every failed attempt */
+#define ADS1015_RECOVERY_MIN_DELAY_MS 1
+#define ADS1015_RECOVERY_MAX_DELAY_MS 1000
+/* failed attempts before giving up until the acquisition is restarted */
+#define ADS1015_RECOVERY_MAX_ATTEMPTS 16
+
+/* conversion periods without a conversion-ready edge before resyncing */
+#define ADS1015_WATCHDOG_PERIODS 4
+
+/*
+ * IRQ storm: more than STORM_FACTOR edges per nominal conversion period
+ * over a window of STORM_PERIODS. The line is masked with a back-off, after
+ * STORM_RETRIES storms in a row CONV is polled from an hrtimer instead.
+ */
+#define ADS1015_STORM_PERIODS 32
+#define ADS1015_STORM_FACTOR 4
+#define ADS1015_STORM_RETRIES 4
+#define ADS1015_STORM_MIN_DELAY_MS 10
+#define ADS1015_STORM_MAX_DELAY_MS 1000
+
+/* data->flags bits */
+#define ADS1015_FLAG_WATCHDOG 0
+#define ADS1015_FLAG_SCHED 1
+#define ADS1015_FLAG_WAKE 2
+
+/*
+ * data->notify_pending bits: attributes changed by the acquisition path,
+ * notified from notify_work as sysfs_notify() may sleep on kernfs_mutex.
+ * One OVERFLOWS bit per stream.
+ */
+#define ADS1015_NOTIFY_ERROR_STATE 0
+#define ADS1015_NOTIFY_SCAN_CONFIG 1
+#define ADS1015_NOTIFY_CAPTURE_STATE 2
+#define ADS1015_NOTIFY_IRQ_STORM 3
+#define ADS1015_NOTIFY_BURST_STATE 4
+#define ADS1015_NOTIFY_BURST_READY 5
+#define ADS1015_NOTIFY_OVERFLOWS 6
+
+/*
+ * Shared ALERT/RDY line: an edge belongs to the member furthest into its
+ * conversion period once past EDGE_DUE/16 of it, and also to any member
+ * past EDGE_LATE/16, which converted for sure (merged edges). The periods
+ * are nominal, the internal clock is good to 10%.
+ */
+#define ADS1015_EDGE_DUE 14
+#define ADS1015_EDGE_LATE 18
+
+/* results read in one I2C transfer by the thread of a shared line */
+#define ADS1015_GROUP_BATCH 4
+
+/*
+ * Results read by the hard IRQ handler in atomic mode, the thread is woken
+ * once per batch to push them (power of two)
+ */
+#define ADS1015_RING_SIZE 64
+#define ADS1015_DEFAULT_ATOMIC_BATCH 16
+
+/* scans between two updates of the timestamp reference */
+#define ADS1015_DEFAULT_TS_REF_INTERVAL 128
+
+/* SCHED_FIFO priority the IRQ core gives threaded handlers */
+#define ADS1015_IRQ_THREAD_PRIO (MAX_RT_PRIO / 2)
+
+/* direct reads are served from the cache for one conversion period */
+#define ADS1015_CACHE_MAX_AGE_AUTO -1
+
 enum chip_ids
 {
 	ADS1015,
 	ADS1115,
 };
 
+enum ads1015_state
+{
+	ADS1015_STATE_OK,
+	ADS1015_STATE_RECOVERING,
+	ADS1015_STATE_FAILED,
+};
+
+static const char *const ads1015_state_names[] = {
+	[ADS1015_STATE_OK] = "ok",
+	[ADS1015_STATE_RECOVERING] = "recovering",
+	[ADS1015_STATE_FAILED] = "failed",
+};
+
+enum ads1015_storm_state
+{
+	ADS1015_STORM_NONE,
+	ADS1015_STORM_THROTTLED,
+	ADS1015_STORM_POLLING,
+};
+
+static const char *const ads1015_storm_state_names[] = {
+	[ADS1015_STORM_NONE] = "none",
+	[ADS1015_STORM_THROTTLED] = "throttled",
+	[ADS1015_STORM_POLLING] = "polling",
+};
+
+/* what a full buffer does with the next scan */
+enum ads1015_overflow_policy
+{
+	ADS1015_OVERFLOW_DROP_NEWEST,
+	ADS1015_OVERFLOW_OVERWRITE_OLDEST,
+	ADS1015_OVERFLOW_PAUSE,
+};
+
+static const char *const ads1015_overflow_policy_names[] = {
+	[ADS1015_OVERFLOW_DROP_NEWEST] = "drop_newest",
+	[ADS1015_OVERFLOW_OVERWRITE_OLDEST] = "overwrite_oldest",
+	[ADS1015_OVERFLOW_PAUSE] = "pause",
+};
+
+/* condition on the raw value that freezes the capture ring */
+enum ads1015_capture_mode
+{
+	ADS1015_CAPTURE_OFF,
+	ADS1015_CAPTURE_RISING,
+	ADS1015_CAPTURE_FALLING,
+	ADS1015_CAPTURE_ABOVE,
+	ADS1015_CAPTURE_BELOW,
+};
+
+static const char *const ads1015_capture_mode_names[] = {
+	[ADS1015_CAPTURE_OFF] = "off",
+	[ADS1015_CAPTURE_RISING] = "rising",
+	[ADS1015_CAPTURE_FALLING] = "falling",
+	[ADS1015_CAPTURE_ABOVE] = "above",
+	[ADS1015_CAPTURE_BELOW] = "below",
+};
+
+enum ads1015_capture_state
+{
+	ADS1015_CAPTURE_IDLE,
+	ADS1015_CAPTURE_ARMED,
+	ADS1015_CAPTURE_TRIGGERED,
+	ADS1015_CAPTURE_DONE,
+};
+
+static const char *const ads1015_capture_state_names[] = {
+	[ADS1015_CAPTURE_IDLE] = "idle",
+	[ADS1015_CAPTURE_ARMED] = "armed",
+	[ADS1015_CAPTURE_TRIGGERED] = "triggered",
+	[ADS1015_CAPTURE_DONE] = "done",
+};
+
+enum ads1015_burst_state
+{
+	ADS1015_BURST_IDLE,
+	ADS1015_BURST_RUNNING,
+	ADS1015_BURST_DONE,
+	ADS1015_BURST_OVERRUN,
+};
+
+static const char *const ads1015_burst_state_names[] = {
+	[ADS1015_BURST_IDLE] = "idle",
+	[ADS1015_BURST_RUNNING] = "running",
+	[ADS1015_BURST_DONE] = "done",
+	[ADS1015_BURST_OVERRUN] = "overrun",
+};
+
 enum ads1015_channels
 {
 	ADS1015_AIN0_AIN1 = 0,
@@ -95,9 +287,47 @@ enum ads1015_channels
 	ADS1015_AIN1,
 	ADS1015_AIN2,
 	ADS1015_AIN3,
+	ADS1015_RANGE,
+	ADS1015_SOURCE,
+	ADS1015_PROCESSED,
+	ADS1015_MIN,
+	ADS1015_MAX,
+	ADS1015_RMS,
+	ADS1015_SEQUENCE,
 	ADS1015_TIMESTAMP,
 };
 
+/*
+ * largest scan: every input, range, source, uV, min/max/RMS, sequence and
+ * timestamp
+ */
+#define ADS1015_SCAN_MAX_BYTES 48
+
+/*
+ * Buffers fed by the acquisition path: the one of the main IIO device and
+ * ADS1015_STREAMS - 1 companion devices, each with its own scan mask, buffer
+ * and decimation
+ */
+#define ADS1015_STREAMS 2
+#define ADS1015_MAX_DECIMATION 65535
+
+/* scans copied to userspace per buffer lock hold */
+#define ADS1015_BUFFER_BOUNCE 16
+
+/* pre-trigger capture: records held in total and defaults */
+#define ADS1015_CAPTURE_MAX 65536
+#define ADS1015_CAPTURE_DEFAULT_PRE 256
+#define ADS1015_CAPTURE_DEFAULT_POST 768
+
+/* burst capture: samples per block, blocks in the ring */
+#define ADS1015_BURST_MAX 65536
+#define ADS1015_BURST_DEFAULT_LENGTH 1024
+#define ADS1015_BURST_RING_MAX 16
+#define ADS1015_BURST_DEFAULT_RING 2
+
+/* multi-rate scheduler: bus transfers and wakeup on top of a conversion */
+#define ADS1015_SLOT_OVERHEAD_NS 100000
+
 static const unsigned int ads1015_data_rate[] = {
 	128, 250, 490, 920, 1600, 2400, 3300, 3300};
 
@@ -119,7 +349,10 @@ static int ads1015_fullscale_range[] = {
 		.channel = _chan,                                   \
 		.info_mask_separate = BIT(IIO_CHAN_INFO_RAW) |      \
 							  BIT(IIO_CHAN_INFO_SCALE) |    \
-							  BIT(IIO_CHAN_INFO_SAMP_FREQ), \
+							  BIT(IIO_CHAN_INFO_SAMP_FREQ) |\
+							  BIT(IIO_CHAN_INFO_CALIBBIAS) |\
+							  BIT(IIO_CHAN_INFO_CALIBSCALE)|\
+							  BIT(IIO_CHAN_INFO_PROCESSED), \
 		.scan_index = _addr,                                \
 		.scan_type = {                                      \
 			.sign = 's',                                    \
@@ -129,6 +362,101 @@ static int ads1015_fullscale_range[] = {
 			.endianness = IIO_CPU,                          \
 		},                                                  \
 		.datasheet_name = "AIN" #_chan,                     \
+		.ext_info = ads1015_ext_info,                       \
+	}
+
+/*
+ * Full-scale range in mV the sample of the same scan was converted with,
+ * changes along with the scale under auto-ranging
+ */
+#define ADS1015_RANGE_CHAN(_addr)                           \
+	{                                                       \
+		.type = IIO_VOLTAGE,                                \
+		.address = _addr,                                   \
+		.extend_name = "range",                             \
+		.scan_index = _addr,                                \
+		.scan_type = {                                      \
+			.sign = 'u',                                    \
+			.realbits = 16,                                 \
+			.storagebits = 16,                              \
+			.endianness = IIO_CPU,                          \
+		},                                                  \
+	}
+
+/*
+ * Scan index of the input converted for the scan when several are enabled:
+ * only its element is new, the others hold their previous sample. IIO has
+ * no type for an index, so it goes out as a voltage without a scale: a
+ * plain number, not a level.
+ */
+#define ADS1015_SOURCE_CHAN(_addr)                          \
+	{                                                       \
+		.type = IIO_VOLTAGE,                                \
+		.address = _addr,                                   \
+		.extend_name = "source",                            \
+		.scan_index = _addr,                                \
+		.scan_type = {                                      \
+			.sign = 'u',                                    \
+			.realbits = 16,                                 \
+			.storagebits = 16,                              \
+			.endianness = IIO_CPU,                          \
+		},                                                  \
+	}
+
+/* the sample of the same scan in uV, scaled and calibrated in-kernel */
+#define ADS1015_PROCESSED_CHAN(_addr)                       \
+	{                                                       \
+		.type = IIO_VOLTAGE,                                \
+		.address = _addr,                                   \
+		.extend_name = "processed",                         \
+		.info_mask_separate = BIT(IIO_CHAN_INFO_SCALE),     \
+		.scan_index = _addr,                                \
+		.scan_type = {                                      \
+			.sign = 's',                                    \
+			.realbits = 32,                                 \
+			.storagebits = 32,                              \
+			.endianness = IIO_CPU,                          \
+		},                                                  \
+	}
+
+/*
+ * Spread of the samples averaged into the scan (see decimation) in uV:
+ * the scan sample alone without decimation.
+ */
+#define ADS1015_STATS_CHAN(_addr, _name, _sign)             \
+	{                                                       \
+		.type = IIO_VOLTAGE,                                \
+		.address = _addr,                                   \
+		.extend_name = _name,                               \
+		.info_mask_separate = BIT(IIO_CHAN_INFO_SCALE),     \
+		.scan_index = _addr,                                \
+		.scan_type = {                                      \
+			.sign = _sign,                                  \
+			.realbits = 32,                                 \
+			.storagebits = 32,                              \
+			.endianness = IIO_CPU,                          \
+		},                                                  \
+	}
+
+/*
+ * Conversion-ready edges counted by the hard IRQ handler, including those
+ * whose sample was discarded or lost: gaps mean missing scans.
+ */
+#define ADS1015_SEQ_CHAN(_addr)                             \
+	{                                                       \
+		.type = IIO_COUNT,                                  \
+		.indexed = 1,                                       \
+		.address = _addr,                                   \
+		.channel = 0,                                       \
+		.extend_name = "sequence",                          \
+		.info_mask_separate = BIT(IIO_CHAN_INFO_RAW),       \
+		.scan_index = _addr,                                \
+		.scan_type = {                                      \
+			.sign = 'u',                                    \
+			.realbits = 32,                                 \
+			.storagebits = 32,                              \
+			.endianness = IIO_CPU,                          \
+		},                                                  \
 	}
 
 #define ADS1015_V_DIFF_CHAN(_chan, _chan2, _addr)           \
@@ -141,7 +469,10 @@ static int ads1015_fullscale_range[] = {
 		.channel2 = _chan2,                                 \
 		.info_mask_separate = BIT(IIO_CHAN_INFO_RAW) |      \
 							  BIT(IIO_CHAN_INFO_SCALE) |    \
-							  BIT(IIO_CHAN_INFO_SAMP_FREQ), \
+							  BIT(IIO_CHAN_INFO_SAMP_FREQ) |\
+							  BIT(IIO_CHAN_INFO_CALIBBIAS) |\
+							  BIT(IIO_CHAN_INFO_CALIBSCALE)|\
+							  BIT(IIO_CHAN_INFO_PROCESSED), \
 		.scan_index = _addr,                                \
 		.scan_type = {                                      \
 			.sign = 's',                                    \
@@ -151,6 +482,7 @@ static int ads1015_fullscale_range[] = {
 			.endianness = IIO_CPU,                          \
 		},                                                  \
 		.datasheet_name = "AIN" #_chan "-AIN" #_chan2,      \
+		.ext_info = ads1015_ext_info,                       \
 	}
 
 #define ADS1115_V_CHAN(_chan, _addr)                        \
@@ -161,7 +493,10 @@ static int ads1015_fullscale_range[] = {
 		.channel = _chan,                                   \
 		.info_mask_separate = BIT(IIO_CHAN_INFO_RAW) |      \
 							  BIT(IIO_CHAN_INFO_SCALE) |    \
-							  BIT(IIO_CHAN_INFO_SAMP_FREQ), \
+							  BIT(IIO_CHAN_INFO_SAMP_FREQ) |\
+							  BIT(IIO_CHAN_INFO_CALIBBIAS) |\
+							  BIT(IIO_CHAN_INFO_CALIBSCALE)|\
+							  BIT(IIO_CHAN_INFO_PROCESSED), \
 		.scan_index = _addr,                                \
 		.scan_type = {                                      \
 			.sign = 's',                                    \
@@ -170,6 +505,7 @@ static int ads1015_fullscale_range[] = {
 			.endianness = IIO_CPU,                          \
 		},                                                  \
 		.datasheet_name = "AIN" #_chan,                     \
+		.ext_info = ads1015_ext_info,                       \
 	}
 
 #define ADS1115_V_DIFF_CHAN(_chan, _chan2, _addr)           \
@@ -182,7 +518,10 @@ static int ads1015_fullscale_range[] = {
 		.channel2 = _chan2,                                 \
 		.info_mask_separate = BIT(IIO_CHAN_INFO_RAW) |      \
 							  BIT(IIO_CHAN_INFO_SCALE) |    \
-							  BIT(IIO_CHAN_INFO_SAMP_FREQ), \
+							  BIT(IIO_CHAN_INFO_SAMP_FREQ) |\
+							  BIT(IIO_CHAN_INFO_CALIBBIAS) |\
+							  BIT(IIO_CHAN_INFO_CALIBSCALE)|\
+							  BIT(IIO_CHAN_INFO_PROCESSED), \
 		.scan_index = _addr,                                \
 		.scan_type = {                                      \
 			.sign = 's',                                    \
@@ -191,8 +530,168 @@ static int ads1015_fullscale_range[] = {
 			.endianness = IIO_CPU,                          \
 		},                                                  \
 		.datasheet_name = "AIN" #_chan "-AIN" #_chan2,      \
+		.ext_info = ads1015_ext_info,                       \
 	}
 
+struct ads1015_sample
+{
+	/* CONV register content, i.e. still left aligned */
+	int val;
+	int pga;
+	s64 timestamp;
+	bool valid;
+};
+
+struct ads1015_raw_sample
+{
+	u16 val;
+	u32 seq;
+	s64 timestamp;
+};
+
+/* one record of the capture file, oldest first */
+struct ads1015_capture_sample
+{
+	s64 timestamp;
+	u32 seq;
+	/* same units as in_voltageN_raw */
+	s16 val;
+	/* full-scale range in mV it was converted with */
+	u16 range;
+};
+
+/*
+ * Pre-trigger capture: the ring always holds the latest pre + post results
+ * of the channel; after the condition hits it keeps filling for post
+ * results (the trigger one included) and freezes.
+ */
+struct ads1015_capture
+{
+	enum ads1015_capture_mode mode;
+	enum ads1015_capture_state state;
+	int chan;
+	int level;
+	unsigned int pre;
+	unsigned int post;
+
+	struct ads1015_capture_sample *ring;
+	unsigned int head;
+	unsigned int filled;
+	unsigned int left;
+	int prev;
+	bool prev_valid;
+	/* owns a reference on the acquisition, dropped by done_work */
+	bool held;
+};
+
+/*
+ * Burst capture: ring of blocks of length results of chan, filled in turn
+ * in mem straight from the acquisition. Blocks head - tail are complete and
+ * left alone until read or released through the mapping, the next one is
+ * being filled.
+ */
+struct ads1015_burst
+{
+	enum ads1015_burst_state state;
+	int chan;
+	unsigned int length;
+	unsigned int ring;
+	/* blocks to capture, 0 until stopped */
+	unsigned int blocks;
+
+	s16 *mem;
+	unsigned int head;
+	unsigned int tail;
+	unsigned int fill;
+	/* conversions lost in between two results of the burst */
+	unsigned int missed;
+	u32 seq;
+	/* owns a reference on the acquisition, dropped by done_work */
+	bool held;
+};
+
+struct ads1015_data;
+
+/* integer accumulators of a window of samples */
+struct ads1015_stats
+{
+	unsigned int count;
+	int min;
+	int max;
+	s64 sum;
+	u64 sumsq;
+};
+
+/* windowed statistics of one channel, see in_voltageN_stats_* */
+struct ads1015_chan_stats
+{
+	/* samples per window, 0 when off */
+	unsigned int window;
+	struct ads1015_stats acc;
+
+	/* last complete window in uV */
+	bool valid;
+	int min;
+	int max;
+	int mean;
+	int rms;
+};
+
+enum ads1015_crossing_state
+{
+	ADS1015_CROSSING_UNKNOWN,
+	ADS1015_CROSSING_LOW,
+	ADS1015_CROSSING_HIGH,
+};
+
+/*
+ * Rising crossings of level with hysteresis of one channel: the input has to
+ * drop to level - hysteresis before reaching level + hysteresis counts.
+ */
+struct ads1015_crossing
+{
+	bool enabled;
+	/* in_voltageN_raw units */
+	int level;
+	int hysteresis;
+
+	enum ads1015_crossing_state state;
+	int prev;
+	s64 prev_ts;
+	/* interpolated time of the last crossing, 0 for none yet */
+	s64 last;
+	/* between the last two crossings in ns, 0 for none yet */
+	s64 period;
+};
+
+/* slots of one input in the multi-rate scheduler */
+struct ads1015_sched_chan
+{
+	/* chip DR used for its conversions */
+	int dr;
+	/* 1 / sampling frequency, ns */
+	s64 period;
+	/* earliest start of the next slot, CLOCK_MONOTONIC */
+	s64 release;
+};
+
+struct ads1015_stream
+{
+	struct ads1015_data *data;
+	struct iio_dev *indio_dev;
+	bool enabled;
+
+	/* scans of an input averaged into one pushed scan, 1 for the full rate */
+	unsigned int decimation;
+	struct ads1015_stats acc[ADS1015_CHANNELS];
+	s64 ts_first[ADS1015_CHANNELS];
+
+	/* scan under construction, elements at their natural alignment */
+	u8 scan[ADS1015_SCAN_MAX_BYTES] __aligned(8);
+};
+
+struct ads1015_irq_group;
+
 struct ads1015_data
 {
 	/* Underlying I2C / SPI bus adapter used to abstract
@@ -221,10 +720,254 @@ struct ads1015_data
 	int irq;
 
 	s64 timestamp;
+	u32 seq;
 
 	bool use_buffer;
+
+	/*
+	 * Channel the ADC is converting while buffered capture is running and
+	 * the number of upcoming conversions that still carry the previous
+	 * configuration (a config write only takes effect after the ongoing
+	 * conversion completes).
+	 */
+	int conv_chan;
+	int conv_pga;
+	unsigned int conv_skip;
+
+	/*
+	 * Channel requested by a direct read while buffered capture is
+	 * running, negative if none. The acquisition thread slots it into
+	 * the scan and signals oneshot_done once the result is cached.
+	 */
+	int oneshot_chan;
+	struct completion oneshot_done;
+
+	/* Latest result of every channel, updated by the acquisition path */
+	struct ads1015_sample cache[ADS1015_CHANNELS];
+
+	/*
+	 * Maximum age in us of a cached result still returned by a direct
+	 * read, ADS1015_CACHE_MAX_AGE_AUTO for one conversion period at the
+	 * channel data rate, 0 to always start a new conversion.
+	 */
+	int cache_max_age_us;
+
+	/*
+	 * I2C error recovery: the acquisition thread only flags the error
+	 * and masks the IRQ, recover_work resets the bus and restores the
+	 * registers from the regmap cache with an exponential back-off.
+	 */
+	enum ads1015_state state;
+	struct delayed_work recover_work;
+	unsigned int recover_delay_ms;
+	unsigned int recover_attempts;
+	int last_error;
+	unsigned int error_count;
+	unsigned int recover_count;
+
+	/*
+	 * Conversions numbered so far (sequence numbers), and the edges the
+	 * hard IRQ handler actually saw, which the watchdog goes by: its own
+	 * resync numbers a conversion too.
+	 */
+	atomic_t irq_count;
+	atomic_t edge_count;
+
+	/*
+	 * Restarted every few conversion periods while buffering; if no edge
+	 * came in meanwhile it wakes the IRQ thread to poll CONV and re-arm
+	 * the ALERT/RDY pin.
+	 */
+	struct hrtimer watchdog;
+	unsigned int watchdog_irq_count;
+	unsigned int watchdog_count;
+
+	/*
+	 * IRQ storm detection on a line of our own: edges counted by the hard
+	 * IRQ handler over a window of conversion periods (storm_period when
+	 * it started). A storm masks the line for storm_delay_ms, the next
+	 * ones in a row for twice as long, until poll_timer takes over.
+	 */
+	enum ads1015_storm_state storm_state;
+	s64 storm_start;
+	s64 storm_period;
+	unsigned int storm_edges;
+	unsigned int storm_retries;
+	unsigned int storm_delay_ms;
+	unsigned int storm_count;
+	struct delayed_work storm_work;
+	struct hrtimer poll_timer;
+
+	unsigned long flags;
+
+	/*
+	 * SCHED_FIFO priority of the acquisition (IRQ) thread, applied by
+	 * the thread itself, and the CPUs the IRQ and its thread run on
+	 * (empty: left to the IRQ core).
+	 */
+	unsigned int irq_priority;
+	cpumask_t irq_cpus;
+
+	/*
+	 * ALERT/RDY wired-OR with other ADCs (ti,shared-irq): the IRQ is
+	 * requested once for the group and every edge is handed to the
+	 * member whose conversion it ends, going by edge_ns (CLOCK_MONOTONIC
+	 * of its last edge or conversion start) and edge_period_ns. The group
+	 * thread reads the results of its members in one batch.
+	 */
+	bool shared_irq;
+	struct ads1015_irq_group *group;
+	struct list_head group_node;
+	s64 edge_ns;
+	s64 edge_period_ns;
+	bool batch_valid;
+	unsigned int batch_res;
+
+	/*
+	 * Atomic conversion read: the hard IRQ handler reads the result with
+	 * master_xfer_atomic into a single producer/consumer ring. It cannot
+	 * take the adapter lock, so this is only on (atomic_on) on a root
+	 * adapter we are the only client of, a new client turns it off for
+	 * good through bus_nb, and the handler leaves the bus
+	 * alone while bus_users, our own process context accesses (regmap
+	 * through regmap_lock, direct CONV reads, bus recovery), is non-zero.
+	 * atomic_lock orders the two. edge_read tells the thread the edge it
+	 * was woken for is in the ring.
+	 */
+	bool atomic_read;
+	bool atomic_on;
+	struct notifier_block bus_nb;
+	unsigned int atomic_batch;
+	raw_spinlock_t atomic_lock;
+	struct mutex regmap_lock;
+	unsigned int bus_users;
+	bool edge_read;
+	int atomic_err;
+	unsigned int ring_head;
+	unsigned int ring_tail;
+	unsigned int ring_overruns;
+	struct ads1015_raw_sample ring[ADS1015_RING_SIZE];
+
+	/*
+	 * Sparse timestamps: with in_timestamp_en off userspace rebuilds the
+	 * time of a scan from its sequence number, the reference (ts_ref_seq,
+	 * ts_ref) taken every ts_ref_interval scans and the conversion period
+	 * measured since the first scan (ts_first_seq, ts_first). Sequence
+	 * numbers count conversions, dropped or evicted scans included.
+	 */
+	unsigned int push_count;
+	unsigned int ts_ref_interval;
+	unsigned int ts_ref_countdown;
+	u32 ts_ref_seq;
+	s64 ts_ref;
+	u32 ts_first_seq;
+	s64 ts_first;
+
+	/*
+	 * Buffers sharing the acquisition: it runs while active_streams is
+	 * non-zero, converting scan_chans, which the first user picks and the
+	 * others have to stay within. scan_chan is the lowest of them.
+	 */
+	struct ads1015_stream streams[ADS1015_STREAMS];
+	unsigned int active_streams;
+	unsigned long scan_chans;
+	int scan_chan;
+
+	/*
+	 * Buffers full under the pause policy; once all running ones are,
+	 * the acquisition stops reading the ADC until a reader drains one.
+	 */
+	atomic_t paused_streams;
+
+	struct ads1015_capture capture;
+	struct ads1015_burst burst;
+	struct ads1015_chan_stats stats[ADS1015_CHANNELS];
+	struct ads1015_crossing crossing[ADS1015_CHANNELS];
+
+	/*
+	 * Live reconfiguration: scale or sampling frequency of scan_chan
+	 * changed while streaming (cfg_pending) is written by the acquisition
+	 * thread at the next conversion boundary; the first scan converted
+	 * with it is then reported through scan_config (cfg_changed).
+	 */
+	bool cfg_pending;
+	bool cfg_changed;
+	int scan_pga;
+	int scan_dr;
+	u32 scan_cfg_seq;
+
+	/*
+	 * Per-channel correction applied to every result: calibbias in raw
+	 * LSB, calibscale in micro units and as the Q20 multiplier used.
+	 */
+	int calibbias[ADS1015_CHANNELS];
+	int calibscale[ADS1015_CHANNELS];
+	u32 calibscale_q[ADS1015_CHANNELS];
+
+	/* uV per raw LSB for every PGA setting, Q16 */
+	u32 uv_mult[ARRAY_SIZE(ads1015_fullscale_range)];
+
+	/*
+	 * Conversion-ready edge exported to other IIO devices, polled from
+	 * the hard IRQ handler while one of them is attached.
+	 */
+	struct iio_trigger *trig;
+	bool trig_enabled;
+
+	/*
+	 * Paced by an external trigger or by the scheduler instead: one
+	 * single-shot conversion per input and slot, conv_done completed by
+	 * the RDY edge. The conversion is waited for under conv_lock alone,
+	 * taken before data->lock; acq_gen tells whether the acquisition was
+	 * restarted meanwhile.
+	 */
+	bool single_shot;
+	struct completion conv_done;
+	struct mutex conv_lock;
+	unsigned int acq_gen;
+
+	/*
+	 * Multi-rate scheduler, used when a buffer scans several inputs
+	 * without a trigger: each input is converted at its own sampling
+	 * frequency, earliest deadline first, at a chip DR picked so that all
+	 * the slots fit.
+	 */
+	bool sched_on;
+	struct ads1015_sched_chan sched[ADS1015_CHANNELS];
+	struct hrtimer sched_timer;
+	struct work_struct sched_work;
+	unsigned int sched_overruns;
+
+	/* inputs under auto-ranging, peak of the current window of each */
+	unsigned long autorange;
+	int autorange_peak[ADS1015_CHANNELS];
+	unsigned int autorange_count[ADS1015_CHANNELS];
+
+	/*
+	 * Nothing in the acquisition path may sleep on anything but data->lock
+	 * and the bus: attribute notifications and messages are deferred to
+	 * notify_work, a bit per attribute in notify_pending.
+	 */
+	struct work_struct notify_work;
+	unsigned long notify_pending;
+	/* leaves the acquisition for a capture or burst that stopped */
+	struct work_struct done_work;
+
+	/*
+	 * Latency of the acquisition path since the last reset, from the
+	 * timestamp of a result (its RDY edge) to its push.
+	 */
+	unsigned int lat_count;
+	u64 lat_min_ns;
+	u64 lat_max_ns;
+	u64 lat_sum_ns;
 };
 
+static bool ads1015_is_volatile_reg(struct device *dev, unsigned int reg)
+{
+	return reg == ADS1015_CONV_REG;
+}
+
 static bool ads1015_is_writeable_reg(struct device *dev, unsigned int reg)
 {
 	switch (reg)
@@ -243,32 +986,446 @@ static const struct regmap_config ads1015_regmap_config = {
 	.val_bits = 16,
 	.max_register = ADS1015_HI_THRESH_REG,
 	.writeable_reg = ads1015_is_writeable_reg,
+	/* the cache doubles as the shadow copy used for error recovery */
+	.volatile_reg = ads1015_is_volatile_reg,
+	.cache_type = REGCACHE_RBTREE,
 };
 
-static const struct iio_chan_spec ads1015_channels[] = {
-	ADS1015_V_DIFF_CHAN(0, 1, ADS1015_AIN0_AIN1),
-	ADS1015_V_DIFF_CHAN(0, 3, ADS1015_AIN0_AIN3),
-	ADS1015_V_DIFF_CHAN(1, 3, ADS1015_AIN1_AIN3),
-	ADS1015_V_DIFF_CHAN(2, 3, ADS1015_AIN2_AIN3),
-	ADS1015_V_CHAN(0, ADS1015_AIN0),
-	ADS1015_V_CHAN(1, ADS1015_AIN1),
-	ADS1015_V_CHAN(2, ADS1015_AIN2),
-	ADS1015_V_CHAN(3, ADS1015_AIN3),
-	IIO_CHAN_SOFT_TIMESTAMP(ADS1015_TIMESTAMP),
-};
+static void ads1015_stats_reset(struct ads1015_stats *st)
+{
+	st->count = 0;
+	st->sum = 0;
+	st->sumsq = 0;
+}
 
-static const struct iio_chan_spec ads1115_channels[] = {
-	ADS1115_V_DIFF_CHAN(0, 1, ADS1015_AIN0_AIN1),
-	ADS1115_V_DIFF_CHAN(0, 3, ADS1015_AIN0_AIN3),
-	ADS1115_V_DIFF_CHAN(1, 3, ADS1015_AIN1_AIN3),
-	ADS1115_V_DIFF_CHAN(2, 3, ADS1015_AIN2_AIN3),
-	ADS1115_V_CHAN(0, ADS1015_AIN0),
-	ADS1115_V_CHAN(1, ADS1015_AIN1),
-	ADS1115_V_CHAN(2, ADS1015_AIN2),
+static void ads1015_stats_add(struct ads1015_stats *st, int val)
+{
+	if (!st->count || val < st->min)
+		st->min = val;
+	if (!st->count || val > st->max)
+		st->max = val;
+	st->sum += val;
+	st->sumsq += (s64)val * val;
+	st->count++;
+}
+
+static int ads1015_stats_mean(struct ads1015_stats *st)
+{
+	return div_s64(st->sum, st->count);
+}
+
+static int ads1015_stats_rms(struct ads1015_stats *st)
+{
+	return int_sqrt64(div64_u64(st->sumsq, st->count));
+}
+
+static void ads1015_stream_reset(struct ads1015_stream *stream)
+{
+	int k;
+
+	for (k = 0; k < ADS1015_CHANNELS; k++)
+		ads1015_stats_reset(&stream->acc[k]);
+}
+
+/* data->lock held */
+static void ads1015_crossing_sample(struct ads1015_crossing *zc,
+									struct iio_chan_spec const *chan, int res,
+									s64 timestamp)
+{
+	int shift = chan->scan_type.shift;
+	int val = sign_extend32(res >> shift, 15 - shift);
+	int high = zc->level + zc->hysteresis;
+	s64 t;
+
+	if (val <= zc->level - zc->hysteresis)
+	{
+		zc->state = ADS1015_CROSSING_LOW;
+	}
+	else if (val >= high)
+	{
+		if (zc->state == ADS1015_CROSSING_LOW)
+		{
+			/* between the samples, prev < high <= val */
+			t = zc->prev_ts + div_s64((timestamp - zc->prev_ts) *
+										  (high - zc->prev),
+									  val - zc->prev);
+			if (zc->last)
+				zc->period = t - zc->last;
+			zc->last = t;
+		}
+		zc->state = ADS1015_CROSSING_HIGH;
+	}
+
+	zc->prev = val;
+	zc->prev_ts = timestamp;
+}
+
+static ssize_t ads1015_autorange_read(struct iio_dev *indio_dev,
+									  uintptr_t private,
+									  struct iio_chan_spec const *chan,
+									  char *buf)
+{
+	struct ads1015_data *data = iio_priv(indio_dev);
+
+	return sprintf(buf, "%d\n", test_bit(chan->address, &data->autorange));
+}
+
+static ssize_t ads1015_autorange_write(struct iio_dev *indio_dev,
+									   uintptr_t private,
+									   struct iio_chan_spec const *chan,
+									   const char *buf, size_t len)
+{
+	struct ads1015_data *data = iio_priv(indio_dev);
+	bool val;
+	int ret;
+
+	ret = kstrtobool(buf, &val);
+	if (ret)
+		return ret;
+
+	mutex_lock(&data->lock);
+	if (val)
+		set_bit(chan->address, &data->autorange);
+	else
+		clear_bit(chan->address, &data->autorange);
+	data->autorange_peak[chan->address] = 0;
+	data->autorange_count[chan->address] = 0;
+	mutex_unlock(&data->lock);
+
+	return len;
+}
+
+static int ads1015_acq_get(struct ads1015_data *data, unsigned long chans,
+						   bool triggered);
+static bool ads1015_acq_put(struct ads1015_data *data);
+static int ads1015_acq_release(struct ads1015_data *data);
+
+enum
+{
+	ADS1015_STATS_MIN,
+	ADS1015_STATS_MAX,
+	ADS1015_STATS_MEAN,
+	ADS1015_STATS_RMS,
+};
+
+/* last complete window in mV, uV resolution */
+static ssize_t ads1015_stats_read(struct iio_dev *indio_dev, uintptr_t private,
+								  struct iio_chan_spec const *chan, char *buf)
+{
+	struct ads1015_data *data = iio_priv(indio_dev);
+	struct ads1015_chan_stats *cs = &data->stats[chan->address];
+	int vals[2], uv;
+
+	mutex_lock(&data->lock);
+	if (!cs->valid)
+	{
+		mutex_unlock(&data->lock);
+		return -ENODATA;
+	}
+
+	switch (private)
+	{
+	case ADS1015_STATS_MIN:
+		uv = cs->min;
+		break;
+	case ADS1015_STATS_MAX:
+		uv = cs->max;
+		break;
+	case ADS1015_STATS_MEAN:
+		uv = cs->mean;
+		break;
+	default:
+		uv = cs->rms;
+		break;
+	}
+	mutex_unlock(&data->lock);
+
+	vals[0] = uv / 1000;
+	vals[1] = (uv % 1000) * 1000;
+
+	return iio_format_value(buf, IIO_VAL_INT_PLUS_MICRO, 2, vals);
+}
+
+static ssize_t ads1015_stats_window_read(struct iio_dev *indio_dev,
+										 uintptr_t private,
+										 struct iio_chan_spec const *chan,
+										 char *buf)
+{
+	struct ads1015_data *data = iio_priv(indio_dev);
+
+	return sprintf(buf, "%u\n", data->stats[chan->address].window);
+}
+
+/*
+ * A window starts an acquisition of the channel when nothing else runs, so
+ * the statistics come without a buffer; 0 stops it.
+ */
+static ssize_t ads1015_stats_window_write(struct iio_dev *indio_dev,
+										  uintptr_t private,
+										  struct iio_chan_spec const *chan,
+										  const char *buf, size_t len)
+{
+	struct ads1015_data *data = iio_priv(indio_dev);
+	struct ads1015_chan_stats *cs = &data->stats[chan->address];
+	bool stop = false;
+	unsigned int val;
+	int ret;
+
+	ret = kstrtouint(buf, 10, &val);
+	if (ret)
+		return ret;
+
+	if (val > ADS1015_MAX_DECIMATION)
+		return -EINVAL;
+
+	mutex_lock(&data->lock);
+	if (val && !cs->window)
+		ret = ads1015_acq_get(data, BIT(chan->address), false);
+	else if (!val && cs->window)
+		stop = ads1015_acq_put(data);
+
+	if (!ret)
+	{
+		cs->window = val;
+		cs->valid = false;
+		ads1015_stats_reset(&cs->acc);
+	}
+	mutex_unlock(&data->lock);
+
+	if (stop)
+		ret = ads1015_acq_release(data);
+
+	return ret < 0 ? ret : len;
+}
+
+enum
+{
+	ADS1015_CROSSING_EN,
+	ADS1015_CROSSING_LEVEL,
+	ADS1015_CROSSING_HYSTERESIS,
+	ADS1015_CROSSING_PERIOD,
+	ADS1015_CROSSING_FREQUENCY,
+};
+
+static ssize_t ads1015_crossing_read(struct iio_dev *indio_dev,
+									 uintptr_t private,
+									 struct iio_chan_spec const *chan,
+									 char *buf)
+{
+	struct ads1015_data *data = iio_priv(indio_dev);
+	struct ads1015_crossing *zc = &data->crossing[chan->address];
+	int vals[2];
+	u32 rem;
+	s64 period;
+	u64 freq;
+
+	switch (private)
+	{
+	case ADS1015_CROSSING_EN:
+		return sprintf(buf, "%d\n", zc->enabled);
+	case ADS1015_CROSSING_LEVEL:
+		return sprintf(buf, "%d\n", zc->level);
+	case ADS1015_CROSSING_HYSTERESIS:
+		return sprintf(buf, "%d\n", zc->hysteresis);
+	}
+
+	mutex_lock(&data->lock);
+	period = zc->period;
+	/* the signal is gone after two periods without a crossing */
+	if (iio_get_time_ns(indio_dev) - zc->last > 2 * period)
+		period = 0;
+	mutex_unlock(&data->lock);
+
+	if (!zc->enabled || period <= 0)
+		return -ENODATA;
+
+	if (private == ADS1015_CROSSING_PERIOD)
+	{
+		/* s with ns resolution */
+		vals[0] = div_u64_rem(period, NSEC_PER_SEC, &rem);
+		vals[1] = rem;
+
+		return iio_format_value(buf, IIO_VAL_INT_PLUS_NANO, 2, vals);
+	}
+
+	/* Hz with uHz resolution */
+	freq = div64_u64(NSEC_PER_SEC * 1000000ULL, period);
+	vals[0] = div_u64_rem(freq, 1000000, &rem);
+	vals[1] = rem;
+
+	return iio_format_value(buf, IIO_VAL_INT_PLUS_MICRO, 2, vals);
+}
+
+/* enabling starts an acquisition of the channel like stats_window */
+static ssize_t ads1015_crossing_write(struct iio_dev *indio_dev,
+									  uintptr_t private,
+									  struct iio_chan_spec const *chan,
+									  const char *buf, size_t len)
+{
+	struct ads1015_data *data = iio_priv(indio_dev);
+	struct ads1015_crossing *zc = &data->crossing[chan->address];
+	bool en, stop = false;
+	int ret, val;
+
+	if (private == ADS1015_CROSSING_EN)
+		ret = kstrtobool(buf, &en);
+	else
+		ret = kstrtoint(buf, 10, &val);
+	if (ret)
+		return ret;
+
+	if (private == ADS1015_CROSSING_HYSTERESIS && val < 0)
+		return -EINVAL;
+
+	mutex_lock(&data->lock);
+	switch (private)
+	{
+	case ADS1015_CROSSING_EN:
+		if (en && !zc->enabled)
+			ret = ads1015_acq_get(data, BIT(chan->address), false);
+		else if (!en && zc->enabled)
+			stop = ads1015_acq_put(data);
+		if (!ret)
+			zc->enabled = en;
+		break;
+	case ADS1015_CROSSING_LEVEL:
+		zc->level = val;
+		break;
+	default:
+		zc->hysteresis = val;
+		break;
+	}
+
+	/* the measurement starts over from the next crossing */
+	zc->state = ADS1015_CROSSING_UNKNOWN;
+	zc->last = 0;
+	zc->period = 0;
+	mutex_unlock(&data->lock);
+
+	if (stop)
+		ret = ads1015_acq_release(data);
+
+	return ret < 0 ? ret : len;
+}
+
+static const struct iio_chan_spec_ext_info ads1015_ext_info[] = {
+	{
+		.name = "autorange",
+		.shared = IIO_SEPARATE,
+		.read = ads1015_autorange_read,
+		.write = ads1015_autorange_write,
+	},
+	{
+		.name = "stats_window",
+		.shared = IIO_SEPARATE,
+		.read = ads1015_stats_window_read,
+		.write = ads1015_stats_window_write,
+	},
+	{
+		.name = "stats_min",
+		.shared = IIO_SEPARATE,
+		.read = ads1015_stats_read,
+		.private = ADS1015_STATS_MIN,
+	},
+	{
+		.name = "stats_max",
+		.shared = IIO_SEPARATE,
+		.read = ads1015_stats_read,
+		.private = ADS1015_STATS_MAX,
+	},
+	{
+		.name = "stats_mean",
+		.shared = IIO_SEPARATE,
+		.read = ads1015_stats_read,
+		.private = ADS1015_STATS_MEAN,
+	},
+	{
+		.name = "stats_rms",
+		.shared = IIO_SEPARATE,
+		.read = ads1015_stats_read,
+		.private = ADS1015_STATS_RMS,
+	},
+	{
+		.name = "crossing_en",
+		.shared = IIO_SEPARATE,
+		.read = ads1015_crossing_read,
+		.write = ads1015_crossing_write,
+		.private = ADS1015_CROSSING_EN,
+	},
+	{
+		.name = "crossing_level",
+		.shared = IIO_SEPARATE,
+		.read = ads1015_crossing_read,
+		.write = ads1015_crossing_write,
+		.private = ADS1015_CROSSING_LEVEL,
+	},
+	{
+		.name = "crossing_hysteresis",
+		.shared = IIO_SEPARATE,
+		.read = ads1015_crossing_read,
+		.write = ads1015_crossing_write,
+		.private = ADS1015_CROSSING_HYSTERESIS,
+	},
+	{
+		.name = "crossing_period",
+		.shared = IIO_SEPARATE,
+		.read = ads1015_crossing_read,
+		.private = ADS1015_CROSSING_PERIOD,
+	},
+	{
+		.name = "crossing_frequency",
+		.shared = IIO_SEPARATE,
+		.read = ads1015_crossing_read,
+		.private = ADS1015_CROSSING_FREQUENCY,
+	},
+	{},
+};
+
+static const struct iio_chan_spec ads1015_channels[] = {
+	ADS1015_V_DIFF_CHAN(0, 1, ADS1015_AIN0_AIN1),
+	ADS1015_V_DIFF_CHAN(0, 3, ADS1015_AIN0_AIN3),
+	ADS1015_V_DIFF_CHAN(1, 3, ADS1015_AIN1_AIN3),
+	ADS1015_V_DIFF_CHAN(2, 3, ADS1015_AIN2_AIN3),
+	ADS1015_V_CHAN(0, ADS1015_AIN0),
+	ADS1015_V_CHAN(1, ADS1015_AIN1),
+	ADS1015_V_CHAN(2, ADS1015_AIN2),
+	ADS1015_V_CHAN(3, ADS1015_AIN3),
+	ADS1015_RANGE_CHAN(ADS1015_RANGE),
+	ADS1015_SOURCE_CHAN(ADS1015_SOURCE),
+	ADS1015_PROCESSED_CHAN(ADS1015_PROCESSED),
+	ADS1015_STATS_CHAN(ADS1015_MIN, "min", 's'),
+	ADS1015_STATS_CHAN(ADS1015_MAX, "max", 's'),
+	ADS1015_STATS_CHAN(ADS1015_RMS, "rms", 'u'),
+	ADS1015_SEQ_CHAN(ADS1015_SEQUENCE),
+	IIO_CHAN_SOFT_TIMESTAMP(ADS1015_TIMESTAMP),
+};
+
+static const struct iio_chan_spec ads1115_channels[] = {
+	ADS1115_V_DIFF_CHAN(0, 1, ADS1015_AIN0_AIN1),
+	ADS1115_V_DIFF_CHAN(0, 3, ADS1015_AIN0_AIN3),
+	ADS1115_V_DIFF_CHAN(1, 3, ADS1015_AIN1_AIN3),
+	ADS1115_V_DIFF_CHAN(2, 3, ADS1015_AIN2_AIN3),
+	ADS1115_V_CHAN(0, ADS1015_AIN0),
+	ADS1115_V_CHAN(1, ADS1015_AIN1),
+	ADS1115_V_CHAN(2, ADS1015_AIN2),
 	ADS1115_V_CHAN(3, ADS1015_AIN3),
+	ADS1015_RANGE_CHAN(ADS1015_RANGE),
+	ADS1015_SOURCE_CHAN(ADS1015_SOURCE),
+	ADS1015_PROCESSED_CHAN(ADS1015_PROCESSED),
+	ADS1015_STATS_CHAN(ADS1015_MIN, "min", 's'),
+	ADS1015_STATS_CHAN(ADS1015_MAX, "max", 's'),
+	ADS1015_STATS_CHAN(ADS1015_RMS, "rms", 'u'),
+	ADS1015_SEQ_CHAN(ADS1015_SEQUENCE),
 	IIO_CHAN_SOFT_TIMESTAMP(ADS1015_TIMESTAMP),
 };
 
+static int ads1015_set_conv_mode(struct ads1015_data *data, int mode)
+{
+	return regmap_update_bits(data->regmap, ADS1015_CFG_REG,
+							  ADS1015_CFG_MOD_MASK,
+							  mode << ADS1015_CFG_MOD_SHIFT);
+}
+
 static int ads1015_set_power_state(struct ads1015_data *data, bool on)
 {
 	int ret;
@@ -284,459 +1441,4155 @@ static int ads1015_set_power_state(struct ads1015_data *data, bool on)
 	}
 	else
 	{
-		pm_runtime_mark_last_busy(dev);
-		ret = pm_runtime_put_autosuspend(dev);
+		pm_runtime_mark_last_busy(dev);
+		ret = pm_runtime_put_autosuspend(dev);
+	}
+
+	return ret < 0 ? ret : 0;
+}
+
+static int ads1015_count_client(struct device *dev, void *count)
+{
+	if (i2c_verify_client(dev))
+		(*(unsigned int *)count)++;
+
+	return 0;
+}
+
+/*
+ * The hard IRQ handler transfers without the adapter lock: no mux segment
+ * and no other client on the bus.
+ */
+static bool ads1015_atomic_supported(struct ads1015_data *data)
+{
+	struct i2c_client *client = to_i2c_client(regmap_get_device(data->regmap));
+	struct i2c_adapter *adap = client->adapter;
+	unsigned int count = 0;
+
+	if (!adap->algo || !adap->algo->master_xfer_atomic ||
+		i2c_parent_is_i2c_adapter(adap))
+		return false;
+
+	device_for_each_child(&adap->dev, &count, ads1015_count_client);
+
+	return count == 1;
+}
+
+/*
+ * Another client would transfer at the same time as the hard IRQ handler:
+ * stop the atomic reads before it can probe, and for good, the mode only
+ * comes back with the next probe.
+ */
+static int ads1015_bus_notify(struct notifier_block *nb, unsigned long action,
+							  void *ptr)
+{
+	struct ads1015_data *data = container_of(nb, struct ads1015_data, bus_nb);
+	struct device *dev = regmap_get_device(data->regmap);
+	struct i2c_client *client = i2c_verify_client(ptr);
+
+	if (action != BUS_NOTIFY_ADD_DEVICE || !client ||
+		client->adapter != to_i2c_client(dev)->adapter)
+		return NOTIFY_DONE;
+
+	/* a handler past this lock is done with the bus */
+	raw_spin_lock_irq(&data->atomic_lock);
+	WRITE_ONCE(data->atomic_read, false);
+	WRITE_ONCE(data->atomic_on, false);
+	raw_spin_unlock_irq(&data->atomic_lock);
+
+	dev_warn(dev, "new client 0x%02x on the bus, atomic conversion read off\n",
+			 client->addr);
+
+	return NOTIFY_OK;
+}
+
+static void ads1015_bus_unwatch(void *nb)
+{
+	bus_unregister_notifier(&i2c_bus_type, nb);
+}
+
+/* keep the hard IRQ handler off the bus while process context is on it */
+static void ads1015_bus_claim(struct ads1015_data *data)
+{
+	raw_spin_lock_irq(&data->atomic_lock);
+	data->bus_users++;
+	raw_spin_unlock_irq(&data->atomic_lock);
+}
+
+static void ads1015_bus_release(struct ads1015_data *data)
+{
+	raw_spin_lock_irq(&data->atomic_lock);
+	data->bus_users--;
+	raw_spin_unlock_irq(&data->atomic_lock);
+}
+
+static void ads1015_regmap_lock(void *arg)
+{
+	struct ads1015_data *data = arg;
+
+	mutex_lock(&data->regmap_lock);
+	ads1015_bus_claim(data);
+}
+
+static void ads1015_regmap_unlock(void *arg)
+{
+	struct ads1015_data *data = arg;
+
+	ads1015_bus_release(data);
+	mutex_unlock(&data->regmap_lock);
+}
+
+static unsigned int ads1015_conv_time_us(struct ads1015_data *data, int chan)
+{
+	int dr = data->channel_data[chan].data_rate;
+
+	return DIV_ROUND_UP(USEC_PER_SEC, data->data_rate[dr]);
+}
+
+static u64 ads1015_watchdog_timeout_ns(struct ads1015_data *data)
+{
+	unsigned int conv_time = ads1015_conv_time_us(data, data->conv_chan);
+	int chan = READ_ONCE(data->oneshot_chan);
+
+	/* a one-off read may run at a slower rate than the scan */
+	if (chan >= 0)
+		conv_time = max(conv_time, ads1015_conv_time_us(data, chan));
+
+	return (u64)ADS1015_WATCHDOG_PERIODS * conv_time * NSEC_PER_USEC;
+}
+
+/* run the IRQ thread of @data now, on its own or in its group */
+static void ads1015_wake_thread(struct ads1015_data *data)
+{
+	if (data->group)
+	{
+		set_bit(ADS1015_FLAG_WAKE, &data->flags);
+		irq_wake_thread(data->irq, data->group);
+		return;
+	}
+
+	irq_wake_thread(data->irq, iio_priv_to_dev(data));
+}
+
+/* notify @bit's attribute from process context */
+static void ads1015_notify(struct ads1015_data *data, int bit)
+{
+	if (!test_and_set_bit(bit, &data->notify_pending))
+		schedule_work(&data->notify_work);
+}
+
+static void ads1015_notify_work(struct work_struct *work)
+{
+	struct ads1015_data *data = container_of(work, struct ads1015_data,
+											 notify_work);
+	struct kobject *kobj = &iio_priv_to_dev(data)->dev.kobj;
+	int k;
+
+	if (test_and_clear_bit(ADS1015_NOTIFY_ERROR_STATE, &data->notify_pending))
+	{
+		dev_dbg(regmap_get_device(data->regmap), "i2c error %d, recovering",
+				READ_ONCE(data->last_error));
+		sysfs_notify(kobj, NULL, "error_state");
+	}
+	if (test_and_clear_bit(ADS1015_NOTIFY_SCAN_CONFIG, &data->notify_pending))
+		sysfs_notify(kobj, NULL, "scan_config");
+	if (test_and_clear_bit(ADS1015_NOTIFY_CAPTURE_STATE, &data->notify_pending))
+		sysfs_notify(kobj, NULL, "capture_state");
+	if (test_and_clear_bit(ADS1015_NOTIFY_IRQ_STORM, &data->notify_pending))
+		sysfs_notify(kobj, NULL, "irq_storm");
+	if (test_and_clear_bit(ADS1015_NOTIFY_BURST_STATE, &data->notify_pending))
+		sysfs_notify(kobj, NULL, "burst_state");
+	if (test_and_clear_bit(ADS1015_NOTIFY_BURST_READY, &data->notify_pending))
+		sysfs_notify(kobj, NULL, "burst_ready");
+
+	for (k = 0; k < ADS1015_STREAMS; k++)
+	{
+		if (test_and_clear_bit(ADS1015_NOTIFY_OVERFLOWS + k,
+							   &data->notify_pending))
+			sysfs_notify(&data->streams[k].indio_dev->dev.kobj, "buffer",
+						 "overflows");
+	}
+}
+static const struct iio_info ads1015_stream_info;
+
+/* the main IIO device owns streams[0], companions point at theirs */
+static struct ads1015_stream *ads1015_to_stream(struct iio_dev *indio_dev)
+{
+	struct ads1015_data *data;
+
+	if (indio_dev->info == &ads1015_stream_info)
+		return *(struct ads1015_stream **)iio_priv(indio_dev);
+
+	data = iio_priv(indio_dev);
+
+	return &data->streams[0];
+}
+
+static enum hrtimer_restart ads1015_watchdog_fn(struct hrtimer *timer)
+{
+	struct ads1015_data *data = container_of(timer, struct ads1015_data,
+											 watchdog);
+	unsigned int irq_count = atomic_read(&data->edge_count);
+
+	/* acq_put() can't wait for a running callback under data->lock */
+	if (!READ_ONCE(data->active_streams) || READ_ONCE(data->single_shot))
+		return HRTIMER_NORESTART;
+
+	if (irq_count == data->watchdog_irq_count &&
+		data->state == ADS1015_STATE_OK)
+	{
+		set_bit(ADS1015_FLAG_WATCHDOG, &data->flags);
+		ads1015_wake_thread(data);
+	}
+	data->watchdog_irq_count = irq_count;
+
+	hrtimer_forward_now(timer, ns_to_ktime(ads1015_watchdog_timeout_ns(data)));
+
+	return HRTIMER_RESTART;
+}
+
+/*
+ * Scan ring used instead of a kfifo so that a full buffer can either drop
+ * the new scan, overwrite the oldest one or pause the acquisition.
+ */
+struct ads1015_buffer
+{
+	struct iio_buffer buffer;
+	struct iio_dev *indio_dev;
+	struct ads1015_data *data;
+
+	/* serializes readers against reallocation */
+	struct mutex user_lock;
+	/* producer (acquisition) against consumer (read) */
+	spinlock_t lock;
+
+	u8 *storage;
+	u8 *bounce;
+	size_t bytes;
+	unsigned int length;
+	unsigned int first;
+	unsigned int count;
+	bool update_needed;
+
+	enum ads1015_overflow_policy policy;
+	bool paused;
+	/* set on overflow, cleared by the next read: one notification each */
+	bool overflowing;
+	unsigned int overflows;
+};
+
+static inline struct ads1015_buffer *to_ads1015_buffer(struct iio_buffer *r)
+{
+	return container_of(r, struct ads1015_buffer, buffer);
+}
+
+static bool ads1015_paused(struct ads1015_data *data)
+{
+	unsigned int active = READ_ONCE(data->active_streams);
+
+	return active && atomic_read(&data->paused_streams) == active;
+}
+
+static void ads1015_buffer_resume(struct ads1015_buffer *buf)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&buf->lock, flags);
+	if (buf->paused)
+	{
+		buf->paused = false;
+		atomic_dec(&buf->data->paused_streams);
+	}
+	spin_unlock_irqrestore(&buf->lock, flags);
+}
+
+static int ads1015_buffer_store_to(struct iio_buffer *r, const void *data)
+{
+	struct ads1015_buffer *buf = to_ads1015_buffer(r);
+	unsigned long flags;
+	bool notify = false;
+	int ret = 0;
+
+	spin_lock_irqsave(&buf->lock, flags);
+	if (buf->paused)
+	{
+		ret = -EBUSY;
+		goto out;
+	}
+
+	if (buf->count == buf->length)
+	{
+		buf->overflows++;
+		notify = !buf->overflowing;
+		buf->overflowing = true;
+
+		switch (buf->policy)
+		{
+		case ADS1015_OVERFLOW_OVERWRITE_OLDEST:
+			buf->first = (buf->first + 1) % buf->length;
+			buf->count--;
+			break;
+		case ADS1015_OVERFLOW_PAUSE:
+			buf->paused = true;
+			atomic_inc(&buf->data->paused_streams);
+			ret = -EBUSY;
+			goto out;
+		default:
+			ret = -EBUSY;
+			goto out;
+		}
+	}
+
+	memcpy(buf->storage +
+			   ((buf->first + buf->count) % buf->length) * buf->bytes,
+		   data, buf->bytes);
+	buf->count++;
+
+out:
+	spin_unlock_irqrestore(&buf->lock, flags);
+
+	if (notify)
+		ads1015_notify(buf->data, ADS1015_NOTIFY_OVERFLOWS +
+					   (ads1015_to_stream(buf->indio_dev) - buf->data->streams));
+
+	return ret;
+}
+
+static int ads1015_buffer_read_first_n(struct iio_buffer *r, size_t n,
+									   char __user *ubuf)
+{
+	struct ads1015_buffer *buf = to_ads1015_buffer(r);
+	unsigned long flags;
+	unsigned int k, batch;
+	size_t copied = 0;
+	bool resume;
+	int ret = 0;
+
+	mutex_lock(&buf->user_lock);
+	if (!buf->storage || n < buf->bytes)
+	{
+		mutex_unlock(&buf->user_lock);
+		return -EINVAL;
+	}
+
+	while (copied + buf->bytes <= n)
+	{
+		spin_lock_irqsave(&buf->lock, flags);
+		batch = min3(buf->count, (unsigned int)((n - copied) / buf->bytes),
+					 (unsigned int)ADS1015_BUFFER_BOUNCE);
+		for (k = 0; k < batch; k++)
+			memcpy(buf->bounce + k * buf->bytes,
+				   buf->storage +
+					   ((buf->first + k) % buf->length) * buf->bytes,
+				   buf->bytes);
+		buf->first = (buf->first + batch) % buf->length;
+		buf->count -= batch;
+		if (batch)
+			buf->overflowing = false;
+		spin_unlock_irqrestore(&buf->lock, flags);
+
+		if (!batch)
+			break;
+
+		if (copy_to_user(ubuf + copied, buf->bounce, batch * buf->bytes))
+		{
+			ret = -EFAULT;
+			break;
+		}
+		copied += batch * buf->bytes;
+	}
+
+	/* restart a paused acquisition once half of the ring is free */
+	spin_lock_irqsave(&buf->lock, flags);
+	resume = buf->paused && buf->count <= buf->length / 2;
+	spin_unlock_irqrestore(&buf->lock, flags);
+	if (resume)
+		ads1015_buffer_resume(buf);
+
+	mutex_unlock(&buf->user_lock);
+
+	return copied ? copied : ret;
+}
+
+static size_t ads1015_buffer_data_available(struct iio_buffer *r)
+{
+	return READ_ONCE(to_ads1015_buffer(r)->count);
+}
+
+static int ads1015_buffer_request_update(struct iio_buffer *r)
+{
+	struct ads1015_buffer *buf = to_ads1015_buffer(r);
+	int ret = 0;
+
+	mutex_lock(&buf->user_lock);
+	if (buf->update_needed)
+	{
+		kvfree(buf->storage);
+		kfree(buf->bounce);
+		buf->storage = NULL;
+		buf->bounce = NULL;
+
+		if (!r->bytes_per_datum)
+		{
+			ret = -EINVAL;
+			goto out;
+		}
+
+		buf->storage = kvcalloc(r->length, r->bytes_per_datum, GFP_KERNEL);
+		buf->bounce = kcalloc(ADS1015_BUFFER_BOUNCE, r->bytes_per_datum,
+							  GFP_KERNEL);
+		if (!buf->storage || !buf->bounce)
+		{
+			ret = -ENOMEM;
+			goto out;
+		}
+
+		buf->bytes = r->bytes_per_datum;
+		buf->length = r->length;
+		buf->update_needed = false;
+	}
+
+	/* like the kfifo, every enable starts empty */
+	buf->first = 0;
+	buf->count = 0;
+	buf->overflowing = false;
+out:
+	mutex_unlock(&buf->user_lock);
+
+	return ret;
+}
+
+static int ads1015_buffer_set_bytes_per_datum(struct iio_buffer *r, size_t bpd)
+{
+	if (r->bytes_per_datum != bpd)
+	{
+		r->bytes_per_datum = bpd;
+		to_ads1015_buffer(r)->update_needed = true;
+	}
+
+	return 0;
+}
+
+static int ads1015_buffer_set_length(struct iio_buffer *r, unsigned int length)
+{
+	/* same minimum as the kfifo */
+	if (length < 2)
+		length = 2;
+
+	if (r->length != length)
+	{
+		r->length = length;
+		to_ads1015_buffer(r)->update_needed = true;
+	}
+
+	return 0;
+}
+
+static void ads1015_buffer_release(struct iio_buffer *r)
+{
+	struct ads1015_buffer *buf = to_ads1015_buffer(r);
+
+	mutex_destroy(&buf->user_lock);
+	kvfree(buf->storage);
+	kfree(buf->bounce);
+	kfree(buf);
+}
+
+static const struct iio_buffer_access_funcs ads1015_buffer_access = {
+	.store_to = ads1015_buffer_store_to,
+	.read_first_n = ads1015_buffer_read_first_n,
+	.data_available = ads1015_buffer_data_available,
+	.request_update = ads1015_buffer_request_update,
+	.set_bytes_per_datum = ads1015_buffer_set_bytes_per_datum,
+	.set_length = ads1015_buffer_set_length,
+	.release = ads1015_buffer_release,
+	.modes = INDIO_BUFFER_SOFTWARE | INDIO_BUFFER_TRIGGERED,
+};
+
+static ssize_t ads1015_overflow_policy_show(struct device *dev,
+											struct device_attribute *attr,
+											char *buf)
+{
+	struct ads1015_buffer *abuf =
+		to_ads1015_buffer(dev_to_iio_dev(dev)->buffer);
+
+	return sprintf(buf, "%s\n", ads1015_overflow_policy_names[abuf->policy]);
+}
+
+static ssize_t ads1015_overflow_policy_store(struct device *dev,
+											 struct device_attribute *attr,
+											 const char *buf, size_t len)
+{
+	struct ads1015_buffer *abuf =
+		to_ads1015_buffer(dev_to_iio_dev(dev)->buffer);
+	unsigned long flags;
+	int ret;
+
+	ret = sysfs_match_string(ads1015_overflow_policy_names, buf);
+	if (ret < 0)
+		return ret;
+
+	spin_lock_irqsave(&abuf->lock, flags);
+	abuf->policy = ret;
+	spin_unlock_irqrestore(&abuf->lock, flags);
+
+	/* leaving the pause policy must not leave the acquisition stopped */
+	if (ret != ADS1015_OVERFLOW_PAUSE)
+		ads1015_buffer_resume(abuf);
+
+	return len;
+}
+
+static ssize_t ads1015_overflow_policy_available_show(struct device *dev,
+													  struct device_attribute *attr,
+													  char *buf)
+{
+	return sprintf(buf, "%s %s %s\n",
+				   ads1015_overflow_policy_names[ADS1015_OVERFLOW_DROP_NEWEST],
+				   ads1015_overflow_policy_names[ADS1015_OVERFLOW_OVERWRITE_OLDEST],
+				   ads1015_overflow_policy_names[ADS1015_OVERFLOW_PAUSE]);
+}
+
+static ssize_t ads1015_overflows_show(struct device *dev,
+									  struct device_attribute *attr,
+									  char *buf)
+{
+	struct ads1015_buffer *abuf =
+		to_ads1015_buffer(dev_to_iio_dev(dev)->buffer);
+
+	return sprintf(buf, "%u\n", abuf->overflows);
+}
+
+static IIO_DEVICE_ATTR(overflow_policy, 0644, ads1015_overflow_policy_show,
+					   ads1015_overflow_policy_store, 0);
+static IIO_DEVICE_ATTR(overflow_policy_available, 0444,
+					   ads1015_overflow_policy_available_show, NULL, 0);
+/* scans dropped, overwritten or refused, pollable */
+static IIO_DEVICE_ATTR(overflows, 0444, ads1015_overflows_show, NULL, 0);
+
+static const struct attribute *ads1015_buffer_attrs[] = {
+	&iio_dev_attr_overflow_policy.dev_attr.attr,
+	&iio_dev_attr_overflow_policy_available.dev_attr.attr,
+	&iio_dev_attr_overflows.dev_attr.attr,
+	NULL,
+};
+
+static void ads1015_buffer_put(void *buffer)
+{
+	iio_buffer_put(buffer);
+}
+
+static struct iio_buffer *ads1015_buffer_alloc(struct iio_dev *indio_dev,
+											   struct ads1015_data *data)
+{
+	struct device *dev = indio_dev->dev.parent;
+	struct ads1015_buffer *buf;
+
+	buf = kzalloc(sizeof(*buf), GFP_KERNEL);
+	if (!buf)
+		return NULL;
+
+	iio_buffer_init(&buf->buffer);
+	buf->buffer.access = &ads1015_buffer_access;
+	buf->buffer.attrs = ads1015_buffer_attrs;
+	buf->buffer.length = 2;
+	buf->indio_dev = indio_dev;
+	buf->data = data;
+	buf->update_needed = true;
+	mutex_init(&buf->user_lock);
+	spin_lock_init(&buf->lock);
+
+	if (devm_add_action_or_reset(dev, ads1015_buffer_put, &buf->buffer))
+		return NULL;
+
+	return &buf->buffer;
+}
+
+static u64 ads1015_sched_slot_ns(struct ads1015_data *data, int dr)
+{
+	u64 conv = DIV_ROUND_UP(NSEC_PER_SEC, data->data_rate[dr]);
+
+	/* 10% internal clock inaccuracy */
+	return conv + conv / 10 + ADS1015_SLOT_OVERHEAD_NS;
+}
+
+/*
+ * Pick the chip DR of every input of @chans: each starts at its sampling
+ * frequency, then the one whose next faster DR frees the most time is sped
+ * up until all the slots fit in a second.
+ */
+static int ads1015_sched_plan(struct ads1015_data *data, unsigned long chans)
+{
+	struct device *dev = regmap_get_device(data->regmap);
+	const int dr_max = ARRAY_SIZE(ads1015_data_rate) - 1;
+	u64 load, gain, best_gain;
+	unsigned int rate;
+	int chan, best, dr;
+
+	for_each_set_bit(chan, &chans, ADS1015_CHANNELS)
+		data->sched[chan].dr = data->channel_data[chan].data_rate;
+
+	for (;;)
+	{
+		load = 0;
+		best = -1;
+		best_gain = 0;
+		for_each_set_bit(chan, &chans, ADS1015_CHANNELS)
+		{
+			rate = data->data_rate[data->channel_data[chan].data_rate];
+			dr = data->sched[chan].dr;
+			load += rate * ads1015_sched_slot_ns(data, dr);
+			if (dr == dr_max)
+				continue;
+
+			gain = rate * (ads1015_sched_slot_ns(data, dr) -
+						   ads1015_sched_slot_ns(data, dr + 1));
+			if (gain > best_gain)
+			{
+				best = chan;
+				best_gain = gain;
+			}
+		}
+
+		if (load <= NSEC_PER_SEC)
+			break;
+
+		if (best < 0)
+		{
+			dev_dbg(dev, "scan needs %llu ns per s even at full speed",
+					load);
+			return -EINVAL;
+		}
+		data->sched[best].dr++;
+	}
+
+	for_each_set_bit(chan, &chans, ADS1015_CHANNELS)
+	{
+		rate = data->data_rate[data->channel_data[chan].data_rate];
+		data->sched[chan].period = div_u64(NSEC_PER_SEC, rate);
+		dev_dbg(dev, "sched chan=%d rate=%u dr=%u", chan, rate,
+				data->data_rate[data->sched[chan].dr]);
+	}
+
+	return 0;
+}
+
+/* first slots once the conversion in flight is over, data->lock held */
+static void ads1015_sched_start(struct ads1015_data *data)
+{
+	unsigned int conv_time = ads1015_conv_time_us(data, data->conv_chan);
+	s64 start = ktime_get_ns() + 2 * conv_time * NSEC_PER_USEC;
+	int chan;
+
+	for_each_set_bit(chan, &data->scan_chans, ADS1015_CHANNELS)
+		data->sched[chan].release = start;
+
+	data->sched_on = true;
+	hrtimer_start(&data->sched_timer, ns_to_ktime(start), HRTIMER_MODE_ABS);
+}
+
+/*
+ * Join the acquisition of @chans, starting it for the first user: buffers,
+ * the capture engine and the statistics. Only the first user may ask for
+ * triggered pacing, later ones have to stay within its inputs. Several
+ * inputs without a trigger run the scheduler. data->lock held.
+ */
+static int ads1015_acq_get(struct ads1015_data *data, unsigned long chans,
+						   bool triggered)
+{
+	bool sched = !triggered && hweight_long(chans) > 1;
+	int k, ret, chan = __ffs(chans);
+	bool atomic_ok;
+
+	/* an external trigger has to pace the whole acquisition */
+	if (data->active_streams && ((chans & ~data->scan_chans) || triggered))
+		return -EBUSY;
+
+	if (data->active_streams)
+	{
+		data->active_streams++;
+		return 0;
+	}
+
+	/* recovery gave up: one more round, the IRQ is still masked */
+	if (data->state == ADS1015_STATE_FAILED)
+	{
+		data->state = ADS1015_STATE_RECOVERING;
+		data->recover_delay_ms = ADS1015_RECOVERY_MIN_DELAY_MS;
+		data->recover_attempts = 0;
+		schedule_delayed_work(&data->recover_work, 0);
+	}
+
+	if (sched)
+	{
+		ret = ads1015_sched_plan(data, chans);
+		if (ret < 0)
+			return ret;
+	}
+
+	ret = ads1015_set_power_state(data, true);
+	if (ret < 0)
+		return ret;
+
+	if (sched)
+	{
+		/* no RDY edge of the continuous mode may end the first slot */
+		ret = ads1015_set_conv_mode(data, ADS1015_SINGLESHOT);
+		if (ret < 0)
+		{
+			ads1015_set_power_state(data, false);
+			return ret;
+		}
+	}
+
+	/* reprogram the scan channel on the first conversion-ready edge */
+	data->scan_chans = chans;
+	data->scan_chan = chan;
+	data->cfg_pending = false;
+	data->cfg_changed = false;
+	data->scan_pga = data->channel_data[chan].pga;
+	data->scan_dr = data->channel_data[chan].data_rate;
+	data->scan_cfg_seq = atomic_read(&data->irq_count) + 1;
+	data->use_buffer = false;
+	data->conv_skip = 0;
+	data->push_count = 0;
+	data->ts_ref_countdown = 0;
+	for (k = 0; k < ADS1015_CHANNELS; k++)
+		data->cache[k].valid = false;
+	data->active_streams = 1;
+	data->acq_gen++;
+	/* other clients may have shown up on the bus since, see bus_nb */
+	atomic_ok = ads1015_atomic_supported(data);
+	raw_spin_lock_irq(&data->atomic_lock);
+	WRITE_ONCE(data->atomic_on, data->atomic_read && atomic_ok);
+	raw_spin_unlock_irq(&data->atomic_lock);
+	WRITE_ONCE(data->single_shot, triggered || sched);
+	WRITE_ONCE(data->edge_ns, ktime_get_ns());
+
+	if (sched)
+	{
+		ads1015_sched_start(data);
+		return 0;
+	}
+
+	if (data->irq > 0 && !triggered)
+	{
+		data->watchdog_irq_count = atomic_read(&data->edge_count);
+		hrtimer_start(&data->watchdog,
+					  ns_to_ktime(ads1015_watchdog_timeout_ns(data)),
+					  HRTIMER_MODE_REL);
+	}
+
+	return 0;
+}
+
+/*
+ * Leave the acquisition, stopping it after the last user. data->lock held;
+ * true if it stopped, the caller then has to ads1015_acq_release() once
+ * data->lock is dropped.
+ */
+static bool ads1015_acq_put(struct ads1015_data *data)
+{
+	if (--data->active_streams)
+		return false;
+
+	/* nothing will serve a pending one-off request any more */
+	if (data->oneshot_chan >= 0)
+	{
+		data->oneshot_chan = -1;
+		complete_all(&data->oneshot_done);
+	}
+
+	/* a slot queued meanwhile sees sched_on and returns */
+	if (data->sched_on)
+	{
+		data->sched_on = false;
+		hrtimer_try_to_cancel(&data->sched_timer);
+	}
+
+	if (data->single_shot)
+	{
+		/* single-shot conversions left the ADC powered down */
+		WRITE_ONCE(data->single_shot, false);
+		ads1015_set_conv_mode(data, ADS1015_CONTINUOUS);
+		data->conv_invalid = true;
+	}
+
+	/* a running callback stops on its own */
+	hrtimer_try_to_cancel(&data->watchdog);
+
+	return true;
+}
+
+/* second half of a stopping ads1015_acq_put(), without data->lock */
+static int ads1015_acq_release(struct ads1015_data *data)
+{
+	/* stream devices may go away once their buffer is off */
+	flush_work(&data->notify_work);
+
+	return ads1015_set_power_state(data, false);
+}
+
+static int ads1015_buffer_preenable(struct iio_dev *indio_dev)
+{
+	struct ads1015_stream *stream = ads1015_to_stream(indio_dev);
+	struct ads1015_data *data = stream->data;
+	unsigned long chans;
+	int ret;
+
+	chans = *indio_dev->active_scan_mask & GENMASK(ADS1015_CHANNELS - 1, 0);
+
+	mutex_lock(&data->lock);
+	/* the core picks the triggered mode whenever a trigger is set */
+	ret = ads1015_acq_get(data, chans, !!indio_dev->trig);
+	if (!ret)
+	{
+		ads1015_stream_reset(stream);
+		/* inputs not converted yet go out as 0, not as the last session's */
+		memset(stream->scan, 0, sizeof(stream->scan));
+		stream->enabled = true;
+	}
+	mutex_unlock(&data->lock);
+
+	return ret;
+}
+
+static int ads1015_buffer_postdisable(struct iio_dev *indio_dev)
+{
+	struct ads1015_stream *stream = ads1015_to_stream(indio_dev);
+	struct ads1015_data *data = stream->data;
+	bool stop;
+
+	/* a paused buffer no longer holds the others back */
+	ads1015_buffer_resume(to_ads1015_buffer(indio_dev->buffer));
+
+	mutex_lock(&data->lock);
+	stream->enabled = false;
+	stop = ads1015_acq_put(data);
+	mutex_unlock(&data->lock);
+
+	return stop ? ads1015_acq_release(data) : 0;
+}
+
+/* from 5.9 on the core attaches and detaches the pollfunc itself */
+#if LINUX_VERSION_CODE < KERNEL_VERSION(5, 9, 0)
+static int ads1015_buffer_postenable(struct iio_dev *indio_dev)
+{
+	if (!indio_dev->trig)
+		return 0;
+
+	return iio_triggered_buffer_postenable(indio_dev);
+}
+
+static int ads1015_buffer_predisable(struct iio_dev *indio_dev)
+{
+	if (!indio_dev->trig)
+		return 0;
+
+	return iio_triggered_buffer_predisable(indio_dev);
+}
+#endif
+
+/* at least one ADC channel, several are interleaved by the scheduler */
+static bool ads1015_validate_scan_mask(struct iio_dev *indio_dev,
+									   const unsigned long *mask)
+{
+	return bitmap_weight(mask, ADS1015_CHANNELS) > 0;
+}
+
+static const struct iio_buffer_setup_ops ads1015_buffer_setup_ops = {
+	/*
+	 * iio_triggered_buffer_postenable:
+	 * Generic function that simply attaches the pollfunc to the trigger.
+	 * Replace this to mess with hardware state before we attach the
+	 * trigger.
+	 */
+	.preenable = ads1015_buffer_preenable,
+#if LINUX_VERSION_CODE < KERNEL_VERSION(5, 9, 0)
+	.postenable = ads1015_buffer_postenable,
+	.predisable = ads1015_buffer_predisable,
+#endif
+	/*
+	 * iio_triggered_buffer_predisable:
+	 * Generic function that simple detaches the pollfunc from the trigger.
+	 * Replace this to put hardware state back again after the trigger is
+	 * detached but before userspace knows we have disabled the ring.
+	 */
+	.postdisable = ads1015_buffer_postdisable,
+	.validate_scan_mask = &ads1015_validate_scan_mask,
+};
+
+/*
+ * CONV is volatile: read it straight off the bus rather than through
+ * regmap, whose lock would be one more for the acquisition path to wait on.
+ */
+static int ads1015_read_conv(struct ads1015_data *data, int *val)
+{
+	struct i2c_client *client = to_i2c_client(regmap_get_device(data->regmap));
+	int ret;
+
+	ads1015_bus_claim(data);
+	ret = i2c_smbus_read_word_swapped(client, ADS1015_CONV_REG);
+	ads1015_bus_release(data);
+	if (ret < 0)
+		return ret;
+
+	*val = ret;
+
+	return 0;
+}
+
+static int ads1015_get_adc_result(struct ads1015_data *data, int chan, int *val)
+{
+	int ret, pga, dr, dr_old, conv_time;
+	unsigned int old, mask, cfg;
+
+	if (chan < 0 || chan >= ADS1015_CHANNELS)
+		return -EINVAL;
+
+	ret = regmap_read(data->regmap, ADS1015_CFG_REG, &old);
+	if (ret)
+		return ret;
+
+	pga = data->channel_data[chan].pga;
+	dr = data->channel_data[chan].data_rate;
+	mask = ADS1015_CFG_MUX_MASK | ADS1015_CFG_PGA_MASK |
+		   ADS1015_CFG_DR_MASK;
+	cfg = chan << ADS1015_CFG_MUX_SHIFT | pga << ADS1015_CFG_PGA_SHIFT |
+		  dr << ADS1015_CFG_DR_SHIFT;
+
+	cfg = (old & ~mask) | (cfg & mask);
+	if (old != cfg)
+	{
+		ret = regmap_write(data->regmap, ADS1015_CFG_REG, cfg);
+		if (ret)
+			return ret;
+		data->conv_invalid = true;
+		WRITE_ONCE(data->edge_period_ns,
+				   DIV_ROUND_UP(NSEC_PER_SEC, data->data_rate[dr]));
+	}
+	if (data->conv_invalid)
+	{
+		dr_old = (old & ADS1015_CFG_DR_MASK) >> ADS1015_CFG_DR_SHIFT;
+		conv_time = DIV_ROUND_UP(USEC_PER_SEC, data->data_rate[dr_old]);
+		conv_time += DIV_ROUND_UP(USEC_PER_SEC, data->data_rate[dr]);
+		conv_time += conv_time / 10; /* 10% internal clock inaccuracy */
+		usleep_range(conv_time, conv_time + 1);
+		data->conv_invalid = false;
+	}
+
+	return ads1015_read_conv(data, val);
+}
+
+/*
+ * Point the continuously converting ADC at another channel while buffered
+ * capture is running. The conversion in progress still completes with the
+ * old settings, so its result is discarded.
+ */
+static int ads1015_buffer_set_chan(struct ads1015_data *data, int chan)
+{
+	int ret, pga, dr;
+	unsigned int old, mask, cfg;
+
+	ret = regmap_read(data->regmap, ADS1015_CFG_REG, &old);
+	if (ret)
+		return ret;
+
+	pga = data->channel_data[chan].pga;
+	dr = data->channel_data[chan].data_rate;
+	mask = ADS1015_CFG_MUX_MASK | ADS1015_CFG_PGA_MASK |
+		   ADS1015_CFG_DR_MASK;
+	cfg = chan << ADS1015_CFG_MUX_SHIFT | pga << ADS1015_CFG_PGA_SHIFT |
+		  dr << ADS1015_CFG_DR_SHIFT;
+
+	cfg = (old & ~mask) | (cfg & mask);
+	data->conv_chan = chan;
+	data->conv_pga = pga;
+	WRITE_ONCE(data->edge_period_ns,
+			   DIV_ROUND_UP(NSEC_PER_SEC, data->data_rate[dr]));
+	if (old == cfg)
+		return 0;
+
+	ret = regmap_write(data->regmap, ADS1015_CFG_REG, cfg);
+	if (ret)
+		return ret;
+
+	data->conv_skip = 1;
+	data->conv_invalid = true;
+
+	return 0;
+}
+
+/*
+ * Correct a CONV register value: (raw + calibbias) * calibscale, clamped to
+ * the 16-bit register range and with the unused low bits kept clear so the
+ * scan_type (realbits, shift) still describes the result.
+ */
+static int ads1015_calibrate(struct ads1015_data *data,
+							 struct iio_chan_spec const *chan, int res)
+{
+	int shift = chan->scan_type.shift;
+	int idx = chan->address;
+	s64 val;
+
+	if (!data->calibbias[idx] && data->calibscale[idx] == ADS1015_CALIBSCALE_ONE)
+		return res;
+
+	val = (s16)res + data->calibbias[idx] * (1 << shift);
+	val = (val * data->calibscale_q[idx]) >> ADS1015_CALIBSCALE_SHIFT;
+	val = clamp_t(s64, val, S16_MIN, S16_MAX);
+
+	return (u16)(val & ~((1 << shift) - 1));
+}
+
+/* CONV register value converted with @pga to uV, rounded */
+static int ads1015_to_uv(struct ads1015_data *data,
+						 struct iio_chan_spec const *chan, int res, int pga)
+{
+	int shift = chan->scan_type.shift;
+	s64 raw = sign_extend32(res >> shift, 15 - shift);
+
+	return (raw * data->uv_mult[pga] + BIT(ADS1015_UV_MULT_SHIFT - 1)) >>
+		   ADS1015_UV_MULT_SHIFT;
+}
+
+/* as ads1015_to_uv() for a magnitude, up to 32768 (rms of -FS) */
+static unsigned int ads1015_mag_to_uv(struct ads1015_data *data,
+									  struct iio_chan_spec const *chan,
+									  unsigned int mag, int pga)
+{
+	u64 raw = mag >> chan->scan_type.shift;
+
+	return (raw * data->uv_mult[pga] + BIT(ADS1015_UV_MULT_SHIFT - 1)) >>
+		   ADS1015_UV_MULT_SHIFT;
+}
+
+/* the elements in uV rather than in CONV register units */
+static bool ads1015_uv_chan(struct iio_chan_spec const *chan)
+{
+	switch (chan->address)
+	{
+	case ADS1015_PROCESSED:
+	case ADS1015_MIN:
+	case ADS1015_MAX:
+	case ADS1015_RMS:
+		return true;
+	default:
+		return false;
+	}
+}
+
+/* close the window of a channel once it has all its samples */
+static void ads1015_stats_sample(struct ads1015_data *data,
+								 struct iio_chan_spec const *chan, int res)
+{
+	struct ads1015_chan_stats *cs = &data->stats[chan->address];
+	int pga = data->conv_pga;
+
+	ads1015_stats_add(&cs->acc, (s16)res);
+	if (cs->acc.count < cs->window)
+		return;
+
+	cs->min = ads1015_to_uv(data, chan, cs->acc.min, pga);
+	cs->max = ads1015_to_uv(data, chan, cs->acc.max, pga);
+	cs->mean = ads1015_to_uv(data, chan, ads1015_stats_mean(&cs->acc), pga);
+	cs->rms = ads1015_mag_to_uv(data, chan, ads1015_stats_rms(&cs->acc), pga);
+	cs->valid = true;
+	ads1015_stats_reset(&cs->acc);
+}
+
+static int ads1015_set_calibbias(struct ads1015_data *data,
+								 struct iio_chan_spec const *chan, int val)
+{
+	int max = BIT(chan->scan_type.realbits - 1) - 1;
+
+	if (val < -max || val > max)
+		return -EINVAL;
+
+	data->calibbias[chan->address] = val;
+
+	return 0;
+}
+
+static int ads1015_set_calibscale(struct ads1015_data *data, int chan,
+								  int val, int val2)
+{
+	s64 scale = (s64)val * ADS1015_CALIBSCALE_ONE + val2;
+
+	if (scale <= 0 || scale > ADS1015_CALIBSCALE_MAX)
+		return -EINVAL;
+
+	data->calibscale[chan] = scale;
+	data->calibscale_q[chan] = div_u64((u64)scale << ADS1015_CALIBSCALE_SHIFT,
+									   ADS1015_CALIBSCALE_ONE);
+
+	return 0;
+}
+
+static void ads1015_cache_store(struct ads1015_data *data, int chan, int val,
+								int pga, s64 timestamp)
+{
+	data->cache[chan].val = val;
+	data->cache[chan].pga = pga;
+	data->cache[chan].timestamp = timestamp;
+	data->cache[chan].valid = true;
+}
+
+static bool ads1015_cache_is_fresh(struct iio_dev *indio_dev, int chan)
+{
+	struct ads1015_data *data = iio_priv(indio_dev);
+	s64 age, max_age;
+
+	if (!data->cache[chan].valid || !data->cache_max_age_us)
+		return false;
+
+	if (data->cache_max_age_us == ADS1015_CACHE_MAX_AGE_AUTO)
+		max_age = ads1015_conv_time_us(data, chan);
+	else
+		max_age = data->cache_max_age_us;
+
+	age = iio_get_time_ns(indio_dev) - data->cache[chan].timestamp;
+
+	return age >= 0 && age <= max_age * NSEC_PER_USEC;
+}
+
+/*
+ * Direct read while buffered capture is running: channels in the active scan
+ * are answered from the sample cache, any other channel is slotted into the
+ * scan by the acquisition thread for a single conversion. Called with
+ * data->lock held, which is dropped while waiting for the thread.
+ */
+static int ads1015_get_buffered_result(struct iio_dev *indio_dev, int chan,
+									   int *val)
+{
+	struct ads1015_data *data = iio_priv(indio_dev);
+	unsigned int timeout;
+	long left;
+
+	if (chan < 0 || chan >= ADS1015_CHANNELS)
+		return -EINVAL;
+
+	if (data->state != ADS1015_STATE_OK)
+		return -EIO;
+
+	if (data->cache[chan].valid && test_bit(chan, &data->scan_chans))
+	{
+		*val = data->cache[chan].val;
+		return 0;
+	}
+
+	if (data->oneshot_chan >= 0 && data->oneshot_chan != chan)
+		return -EBUSY;
+
+	if (data->oneshot_chan < 0)
+	{
+		data->cache[chan].valid = false;
+		data->oneshot_chan = chan;
+		reinit_completion(&data->oneshot_done);
+	}
+
+	/* finish the current conversion, discard one and convert @chan */
+	timeout = 2 * ads1015_conv_time_us(data, data->conv_chan);
+	timeout += 2 * ads1015_conv_time_us(data, chan);
+	timeout += timeout / 10; /* 10% internal clock inaccuracy */
+
+	mutex_unlock(&data->lock);
+	left = wait_for_completion_interruptible_timeout(&data->oneshot_done,
+													 usecs_to_jiffies(timeout) + 1);
+	mutex_lock(&data->lock);
+
+	if (data->oneshot_chan == chan)
+		data->oneshot_chan = -1;
+
+	if (left < 0)
+		return left;
+
+	if (!data->cache[chan].valid)
+		return left ? -EAGAIN : -ETIMEDOUT;
+
+	*val = data->cache[chan].val;
+
+	return 0;
+}
+
+static int ads1015_set_scale(struct ads1015_data *data,
+							 struct iio_chan_spec const *chan,
+							 int scale, int uscale)
+{
+	int i;
+	int fullscale = div_s64((scale * 1000000LL + uscale) << (chan->scan_type.realbits - 1), 1000000);
+
+	for (i = 0; i < ARRAY_SIZE(ads1015_fullscale_range); i++)
+	{
+		if (ads1015_fullscale_range[i] == fullscale)
+		{
+			data->channel_data[chan->address].pga = i;
+			return 0;
+		}
+	}
+
+	return -EINVAL;
+}
+
+static int ads1015_set_data_rate(struct ads1015_data *data, int chan, int rate)
+{
+	int i;
+
+	for (i = 0; i < ARRAY_SIZE(ads1015_data_rate); i++)
+	{
+		if (data->data_rate[i] == rate)
+		{
+			data->channel_data[chan].data_rate = i;
+			return 0;
+		}
+	}
+
+	return -EINVAL;
+}
+
+/*
+ * Result of @chan as a CONV register value, calibrated, together with the
+ * PGA it was converted with. data->lock held.
+ */
+static int ads1015_read_result(struct iio_dev *indio_dev,
+							   struct iio_chan_spec const *chan, int *val,
+							   int *pga)
+{
+	struct ads1015_data *data = iio_priv(indio_dev);
+	int ret;
+
+	/* the ADC is busy streaming, serve it from the live stream */
+	if (data->active_streams)
+	{
+		ret = ads1015_get_buffered_result(indio_dev, chan->address, val);
+		*pga = data->cache[chan->address].pga;
+		return ret;
+	}
+
+	/* the chip has not finished a newer conversion yet */
+	if (ads1015_cache_is_fresh(indio_dev, chan->address))
+	{
+		*val = data->cache[chan->address].val;
+		*pga = data->cache[chan->address].pga;
+		return 0;
+	}
+
+	ret = iio_device_claim_direct_mode(indio_dev);
+	if (ret)
+		return ret;
+
+	ret = ads1015_set_power_state(data, true);
+	if (ret < 0)
+		goto release_direct;
+
+	ret = ads1015_get_adc_result(data, chan->address, val);
+	if (ret < 0)
+	{
+		ads1015_set_power_state(data, false);
+		goto release_direct;
+	}
+
+	*val = ads1015_calibrate(data, chan, *val);
+	*pga = data->channel_data[chan->address].pga;
+
+	ads1015_cache_store(data, chan->address, *val, *pga,
+						iio_get_time_ns(indio_dev));
+
+	ret = ads1015_set_power_state(data, false);
+
+release_direct:
+	iio_device_release_direct_mode(indio_dev);
+
+	return ret;
+}
+
+static int ads1015_read_raw(struct iio_dev *indio_dev,
+							struct iio_chan_spec const *chan, int *val,
+							int *val2, long mask)
+{
+	int ret, idx;
+	struct ads1015_data *data = iio_priv(indio_dev);
+
+	mutex_lock(&data->lock);
+	switch (mask)
+	{
+	case IIO_CHAN_INFO_RAW:
+	case IIO_CHAN_INFO_PROCESSED:
+		if (chan->type == IIO_COUNT)
+		{
+			*val = atomic_read(&data->irq_count);
+			ret = IIO_VAL_INT;
+			break;
+		}
+
+		ret = ads1015_read_result(indio_dev, chan, val, &idx);
+		if (ret < 0)
+			break;
+
+		if (mask == IIO_CHAN_INFO_RAW)
+		{
+			*val = sign_extend32(*val >> chan->scan_type.shift,
+								 15 - chan->scan_type.shift);
+			ret = IIO_VAL_INT;
+			break;
+		}
+
+		/* mV with uV resolution */
+		ret = ads1015_to_uv(data, chan, *val, idx);
+		*val = ret / 1000;
+		*val2 = (ret % 1000) * 1000;
+		ret = IIO_VAL_INT_PLUS_MICRO;
+		break;
+	case IIO_CHAN_INFO_SCALE:
+		if (ads1015_uv_chan(chan))
+		{
+			/* uV */
+			*val = 0;
+			*val2 = 1000;
+			ret = IIO_VAL_INT_PLUS_MICRO;
+			break;
+		}
+
+		idx = data->channel_data[chan->address].pga;
+		*val = ads1015_fullscale_range[idx];
+		*val2 = chan->scan_type.realbits - 1;
+		ret = IIO_VAL_FRACTIONAL_LOG2;
+		break;
+	case IIO_CHAN_INFO_SAMP_FREQ:
+		idx = data->channel_data[chan->address].data_rate;
+		*val = data->data_rate[idx];
+		ret = IIO_VAL_INT;
+		break;
+	case IIO_CHAN_INFO_CALIBBIAS:
+		*val = data->calibbias[chan->address];
+		ret = IIO_VAL_INT;
+		break;
+	case IIO_CHAN_INFO_CALIBSCALE:
+		*val = data->calibscale[chan->address] / ADS1015_CALIBSCALE_ONE;
+		*val2 = data->calibscale[chan->address] % ADS1015_CALIBSCALE_ONE;
+		ret = IIO_VAL_INT_PLUS_MICRO;
+		break;
+	default:
+		ret = -EINVAL;
+		break;
+	}
+	mutex_unlock(&data->lock);
+
+	return ret;
+}
+
+static int ads1015_write_raw(struct iio_dev *indio_dev,
+							 struct iio_chan_spec const *chan, int val,
+							 int val2, long mask)
+{
+	struct ads1015_data *data = iio_priv(indio_dev);
+	int ret;
+
+	mutex_lock(&data->lock);
+	switch (mask)
+	{
+	case IIO_CHAN_INFO_SCALE:
+		ret = ads1015_set_scale(data, chan, val, val2);
+		break;
+	case IIO_CHAN_INFO_SAMP_FREQ:
+		/* the scheduler planned its slots around the rate */
+		if (data->sched_on && test_bit(chan->address, &data->scan_chans))
+			ret = -EBUSY;
+		else
+			ret = ads1015_set_data_rate(data, chan->address, val);
+		break;
+	case IIO_CHAN_INFO_CALIBBIAS:
+		ret = ads1015_set_calibbias(data, chan, val);
+		break;
+	case IIO_CHAN_INFO_CALIBSCALE:
+		ret = ads1015_set_calibscale(data, chan->address, val, val2);
+		break;
+	default:
+		ret = -EINVAL;
+		break;
+	}
+
+	/* cached result was taken with the previous settings */
+	if (!ret)
+		data->cache[chan->address].valid = false;
+
+	/* streaming: the acquisition thread applies it at the next boundary */
+	if (!ret && data->active_streams && chan->address == data->scan_chan &&
+		(mask == IIO_CHAN_INFO_SCALE || mask == IIO_CHAN_INFO_SAMP_FREQ))
+		data->cfg_pending = true;
+	mutex_unlock(&data->lock);
+
+	return ret;
+}
+
+static ssize_t ads1015_cache_max_age_show(struct device *dev,
+										  struct device_attribute *attr,
+										  char *buf)
+{
+	struct ads1015_data *data = iio_priv(dev_to_iio_dev(dev));
+
+	return sprintf(buf, "%d\n", data->cache_max_age_us);
+}
+
+static ssize_t ads1015_cache_max_age_store(struct device *dev,
+										   struct device_attribute *attr,
+										   const char *buf, size_t len)
+{
+	struct ads1015_data *data = iio_priv(dev_to_iio_dev(dev));
+	int ret, val;
+
+	ret = kstrtoint(buf, 10, &val);
+	if (ret)
+		return ret;
+
+	mutex_lock(&data->lock);
+	data->cache_max_age_us = val < 0 ? ADS1015_CACHE_MAX_AGE_AUTO : val;
+	mutex_unlock(&data->lock);
+
+	return len;
+}
+
+static IIO_DEVICE_ATTR(cache_max_age_us, 0644, ads1015_cache_max_age_show,
+					   ads1015_cache_max_age_store, 0);
+
+static ssize_t ads1015_error_state_show(struct device *dev,
+										struct device_attribute *attr,
+										char *buf)
+{
+	struct ads1015_data *data = iio_priv(dev_to_iio_dev(dev));
+
+	return sprintf(buf, "%s\n", ads1015_state_names[data->state]);
+}
+
+static ssize_t ads1015_error_count_show(struct device *dev,
+										struct device_attribute *attr,
+										char *buf)
+{
+	struct ads1015_data *data = iio_priv(dev_to_iio_dev(dev));
+
+	return sprintf(buf, "%u %u\n", data->error_count, data->recover_count);
+}
+
+static IIO_DEVICE_ATTR(error_state, 0444, ads1015_error_state_show, NULL, 0);
+/* i2c errors seen by the acquisition thread, successful recoveries */
+static IIO_DEVICE_ATTR(error_count, 0444, ads1015_error_count_show, NULL, 0);
+
+static ssize_t ads1015_sched_overruns_show(struct device *dev,
+										   struct device_attribute *attr,
+										   char *buf)
+{
+	struct ads1015_data *data = iio_priv(dev_to_iio_dev(dev));
+
+	return sprintf(buf, "%u\n", data->sched_overruns);
+}
+
+/* scheduler slots started more than a period late */
+static IIO_DEVICE_ATTR(sched_overruns, 0444, ads1015_sched_overruns_show,
+					   NULL, 0);
+
+static ssize_t ads1015_watchdog_count_show(struct device *dev,
+										   struct device_attribute *attr,
+										   char *buf)
+{
+	struct ads1015_data *data = iio_priv(dev_to_iio_dev(dev));
+
+	return sprintf(buf, "%u\n", data->watchdog_count);
+}
+
+static IIO_DEVICE_ATTR(watchdog_count, 0444, ads1015_watchdog_count_show,
+					   NULL, 0);
+
+/* "state count" of IRQ storms, any write unmasks the line again */
+static ssize_t ads1015_irq_storm_show(struct device *dev,
+									  struct device_attribute *attr, char *buf)
+{
+	struct ads1015_data *data = iio_priv(dev_to_iio_dev(dev));
+
+	return sprintf(buf, "%s %u\n",
+				   ads1015_storm_state_names[READ_ONCE(data->storm_state)],
+				   data->storm_count);
+}
+
+static ssize_t ads1015_irq_storm_store(struct device *dev,
+									   struct device_attribute *attr,
+									   const char *buf, size_t len)
+{
+	struct ads1015_data *data = iio_priv(dev_to_iio_dev(dev));
+
+	mutex_lock(&data->lock);
+
+	/* the line is masked in both states, the handler keeps off */
+	cancel_delayed_work_sync(&data->storm_work);
+	if (data->storm_state != ADS1015_STORM_NONE)
+	{
+		hrtimer_cancel(&data->poll_timer);
+		data->storm_retries = 0;
+		data->storm_delay_ms = ADS1015_STORM_MIN_DELAY_MS;
+		data->storm_start = ktime_get_ns();
+		data->storm_edges = 0;
+		WRITE_ONCE(data->storm_state, ADS1015_STORM_NONE);
+		enable_irq(data->irq);
+	}
+
+	mutex_unlock(&data->lock);
+
+	return len;
+}
+
+static IIO_DEVICE_ATTR(irq_storm, 0644, ads1015_irq_storm_show,
+					   ads1015_irq_storm_store, 0);
+
+/* "count min avg max" of the push latency in ns, any write resets it */
+static ssize_t ads1015_latency_show(struct device *dev,
+									struct device_attribute *attr, char *buf)
+{
+	struct ads1015_data *data = iio_priv(dev_to_iio_dev(dev));
+	u64 min = 0, avg = 0, max = 0;
+	unsigned int count;
+
+	mutex_lock(&data->lock);
+	count = data->lat_count;
+	if (count)
+	{
+		min = data->lat_min_ns;
+		avg = div_u64(data->lat_sum_ns, count);
+		max = data->lat_max_ns;
+	}
+	mutex_unlock(&data->lock);
+
+	return sprintf(buf, "%u %llu %llu %llu\n", count, min, avg, max);
+}
+
+static ssize_t ads1015_latency_store(struct device *dev,
+									 struct device_attribute *attr,
+									 const char *buf, size_t len)
+{
+	struct ads1015_data *data = iio_priv(dev_to_iio_dev(dev));
+
+	mutex_lock(&data->lock);
+	data->lat_count = 0;
+	data->lat_max_ns = 0;
+	data->lat_sum_ns = 0;
+	mutex_unlock(&data->lock);
+
+	return len;
+}
+
+static IIO_DEVICE_ATTR(latency, 0644, ads1015_latency_show,
+					   ads1015_latency_store, 0);
+
+static ssize_t ads1015_irq_priority_show(struct device *dev,
+										 struct device_attribute *attr,
+										 char *buf)
+{
+	struct ads1015_data *data = iio_priv(dev_to_iio_dev(dev));
+
+	return sprintf(buf, "%u\n", data->irq_priority);
+}
+
+static ssize_t ads1015_irq_priority_store(struct device *dev,
+										  struct device_attribute *attr,
+										  const char *buf, size_t len)
+{
+	struct iio_dev *indio_dev = dev_to_iio_dev(dev);
+	struct ads1015_data *data = iio_priv(indio_dev);
+	unsigned int val;
+	int ret;
+
+	if (data->irq <= 0)
+		return -ENODEV;
+
+	ret = kstrtouint(buf, 10, &val);
+	if (ret)
+		return ret;
+
+	if (val < 1 || val >= MAX_RT_PRIO)
+		return -EINVAL;
+
+	data->irq_priority = val;
+	set_bit(ADS1015_FLAG_SCHED, &data->flags);
+	ads1015_wake_thread(data);
+
+	return len;
+}
+
+static ssize_t ads1015_irq_affinity_show(struct device *dev,
+										 struct device_attribute *attr,
+										 char *buf)
+{
+	struct ads1015_data *data = iio_priv(dev_to_iio_dev(dev));
+
+	return sprintf(buf, "%*pbl\n", cpumask_pr_args(&data->irq_cpus));
+}
+
+static ssize_t ads1015_irq_affinity_store(struct device *dev,
+										  struct device_attribute *attr,
+										  const char *buf, size_t len)
+{
+	struct ads1015_data *data = iio_priv(dev_to_iio_dev(dev));
+	cpumask_t cpus, old;
+	int ret;
+
+	if (data->irq <= 0)
+		return -ENODEV;
+
+	ret = cpulist_parse(buf, &cpus);
+	if (ret)
+		return ret;
+
+	if (cpumask_empty(&cpus) || !cpumask_subset(&cpus, cpu_online_mask))
+		return -EINVAL;
+
+	/*
+	 * The IRQ thread follows the affinity of its IRQ. The IRQ core keeps
+	 * the hint pointer, so it has to be irq_cpus.
+	 */
+	mutex_lock(&data->lock);
+	cpumask_copy(&old, &data->irq_cpus);
+	cpumask_copy(&data->irq_cpus, &cpus);
+	ret = irq_set_affinity_hint(data->irq, &data->irq_cpus);
+	if (ret)
+		cpumask_copy(&data->irq_cpus, &old);
+	mutex_unlock(&data->lock);
+
+	return ret ? ret : len;
+}
+
+static ssize_t ads1015_atomic_conv_read_show(struct device *dev,
+											 struct device_attribute *attr,
+											 char *buf)
+{
+	struct ads1015_data *data = iio_priv(dev_to_iio_dev(dev));
+
+	return sprintf(buf, "%d\n", data->atomic_read);
+}
+
+static ssize_t ads1015_atomic_batch_show(struct device *dev,
+										 struct device_attribute *attr,
+										 char *buf)
+{
+	struct ads1015_data *data = iio_priv(dev_to_iio_dev(dev));
+
+	return sprintf(buf, "%u\n", data->atomic_batch);
+}
+
+static ssize_t ads1015_atomic_batch_store(struct device *dev,
+										  struct device_attribute *attr,
+										  const char *buf, size_t len)
+{
+	struct ads1015_data *data = iio_priv(dev_to_iio_dev(dev));
+	unsigned int val;
+	int ret;
+
+	ret = kstrtouint(buf, 10, &val);
+	if (ret)
+		return ret;
+
+	if (val < 1 || val > ADS1015_RING_SIZE / 2)
+		return -EINVAL;
+
+	WRITE_ONCE(data->atomic_batch, val);
+
+	return len;
+}
+
+static ssize_t ads1015_atomic_overruns_show(struct device *dev,
+											struct device_attribute *attr,
+											char *buf)
+{
+	struct ads1015_data *data = iio_priv(dev_to_iio_dev(dev));
+
+	return sprintf(buf, "%u\n", data->ring_overruns);
+}
+
+static ssize_t ads1015_timestamp_ref_show(struct device *dev,
+										  struct device_attribute *attr,
+										  char *buf)
+{
+	struct ads1015_data *data = iio_priv(dev_to_iio_dev(dev));
+	u32 seq, count;
+	s64 timestamp;
+	u64 period;
+
+	mutex_lock(&data->lock);
+	/* triggered or scheduled conversions are not evenly spaced */
+	if (data->single_shot)
+	{
+		mutex_unlock(&data->lock);
+		return -EOPNOTSUPP;
+	}
+
+	if (!data->push_count)
+	{
+		mutex_unlock(&data->lock);
+		return -ENODATA;
+	}
+
+	seq = data->ts_ref_seq;
+	timestamp = data->ts_ref;
+	count = seq - data->ts_first_seq;
+	/* measured rather than nominal: the internal clock is only 10% */
+	if (count)
+		period = div_u64(timestamp - data->ts_first, count);
+	else
+		period = (u64)ads1015_conv_time_us(data, data->conv_chan) *
+				 NSEC_PER_USEC;
+	mutex_unlock(&data->lock);
+
+	return sprintf(buf, "%u %lld %llu\n", seq, timestamp, period);
+}
+
+static ssize_t ads1015_timestamp_ref_interval_show(struct device *dev,
+												   struct device_attribute *attr,
+												   char *buf)
+{
+	struct ads1015_data *data = iio_priv(dev_to_iio_dev(dev));
+
+	return sprintf(buf, "%u\n", data->ts_ref_interval);
+}
+
+static ssize_t ads1015_timestamp_ref_interval_store(struct device *dev,
+													struct device_attribute *attr,
+													const char *buf, size_t len)
+{
+	struct ads1015_data *data = iio_priv(dev_to_iio_dev(dev));
+	unsigned int val;
+	int ret;
+
+	ret = kstrtouint(buf, 10, &val);
+	if (ret)
+		return ret;
+
+	if (!val)
+		return -EINVAL;
+
+	mutex_lock(&data->lock);
+	data->ts_ref_interval = val;
+	data->ts_ref_countdown = min(data->ts_ref_countdown, val);
+	mutex_unlock(&data->lock);
+
+	return len;
+}
+
+static ssize_t ads1015_scan_config_show(struct device *dev,
+										struct device_attribute *attr,
+										char *buf)
+{
+	struct iio_dev *indio_dev = dev_to_iio_dev(dev);
+	struct ads1015_data *data = iio_priv(indio_dev);
+	const struct iio_chan_spec *chan;
+	unsigned int rate;
+	u32 seq, frac;
+	u64 scale;
+
+	mutex_lock(&data->lock);
+	if (!data->active_streams)
+	{
+		mutex_unlock(&data->lock);
+		return -ENODATA;
+	}
+
+	chan = &indio_dev->channels[data->scan_chan];
+	seq = data->scan_cfg_seq;
+	scale = div_u64((u64)ads1015_fullscale_range[data->scan_pga] *
+						1000000,
+					1 << (chan->scan_type.realbits - 1));
+	rate = data->data_rate[data->scan_dr];
+	mutex_unlock(&data->lock);
+
+	scale = div_u64_rem(scale, 1000000, &frac);
+
+	return sprintf(buf, "%u %llu.%06u %u\n", seq, scale, frac, rate);
+}
+
+static ssize_t ads1015_capture_mode_show(struct device *dev,
+										 struct device_attribute *attr,
+										 char *buf)
+{
+	struct ads1015_data *data = iio_priv(dev_to_iio_dev(dev));
+
+	return sprintf(buf, "%s\n", ads1015_capture_mode_names[data->capture.mode]);
+}
+
+/* stop the capture engine, data->lock held. As ads1015_acq_put() */
+static bool ads1015_capture_stop(struct ads1015_data *data)
+{
+	struct ads1015_capture *c = &data->capture;
+	bool stop = false;
+
+	if (c->held)
+		stop = ads1015_acq_put(data);
+
+	c->held = false;
+	c->state = ADS1015_CAPTURE_IDLE;
+	c->mode = ADS1015_CAPTURE_OFF;
+	kvfree(c->ring);
+	c->ring = NULL;
+
+	return stop;
+}
+
+/*
+ * Leave the acquisition once a capture is done or a burst is over, the
+ * thread can't wait for the teardown.
+ */
+static void ads1015_done_work(struct work_struct *work)
+{
+	struct ads1015_data *data = container_of(work, struct ads1015_data,
+											 done_work);
+	struct ads1015_capture *c = &data->capture;
+	struct ads1015_burst *b = &data->burst;
+	bool stop = false;
+
+	mutex_lock(&data->lock);
+	/* unless they were restarted or stopped since */
+	if (c->held && c->state == ADS1015_CAPTURE_DONE)
+	{
+		c->held = false;
+		stop |= ads1015_acq_put(data);
+	}
+	if (b->held && (b->state == ADS1015_BURST_DONE ||
+					b->state == ADS1015_BURST_OVERRUN))
+	{
+		b->held = false;
+		stop |= ads1015_acq_put(data);
+	}
+	mutex_unlock(&data->lock);
+
+	if (stop)
+		ads1015_acq_release(data);
+}
+
+/* any mode but off (re)arms the capture, dropping a previous one */
+static ssize_t ads1015_capture_mode_store(struct device *dev,
+										  struct device_attribute *attr,
+										  const char *buf, size_t len)
+{
+	struct iio_dev *indio_dev = dev_to_iio_dev(dev);
+	struct ads1015_data *data = iio_priv(indio_dev);
+	struct ads1015_capture *c = &data->capture;
+	struct ads1015_capture_sample *ring = NULL;
+	unsigned int total = 0;
+	int ret = 0, mode;
+	bool stop;
+
+	mode = sysfs_match_string(ads1015_capture_mode_names, buf);
+	if (mode < 0)
+		return mode;
+
+	/* not under data->lock, the acquisition would wait for it */
+	if (mode != ADS1015_CAPTURE_OFF)
+	{
+		total = READ_ONCE(c->pre) + READ_ONCE(c->post);
+		ring = kvcalloc(total, sizeof(*ring), GFP_KERNEL);
+		if (!ring)
+			return -ENOMEM;
+	}
+
+	mutex_lock(&data->lock);
+	stop = ads1015_capture_stop(data);
+	if (mode == ADS1015_CAPTURE_OFF)
+		goto out;
+
+	/* the window was resized in between */
+	if (c->pre + c->post != total)
+	{
+		ret = -EAGAIN;
+		goto out;
+	}
+
+	ret = ads1015_acq_get(data, BIT(c->chan), false);
+	if (ret < 0)
+		goto out;
+
+	c->ring = ring;
+	ring = NULL;
+	c->mode = mode;
+	c->state = ADS1015_CAPTURE_ARMED;
+	c->held = true;
+	c->head = 0;
+	c->filled = 0;
+	c->prev_valid = false;
+out:
+	mutex_unlock(&data->lock);
+
+	kvfree(ring);
+	if (stop)
+		ads1015_acq_release(data);
+
+	sysfs_notify(&indio_dev->dev.kobj, NULL, "capture_state");
+
+	return ret < 0 ? ret : len;
+}
+
+static ssize_t ads1015_capture_mode_available_show(struct device *dev,
+												   struct device_attribute *attr,
+												   char *buf)
+{
+	return sprintf(buf, "off rising falling above below\n");
+}
+
+static ssize_t ads1015_capture_state_show(struct device *dev,
+										  struct device_attribute *attr,
+										  char *buf)
+{
+	struct ads1015_data *data = iio_priv(dev_to_iio_dev(dev));
+
+	return sprintf(buf, "%s\n",
+				   ads1015_capture_state_names[data->capture.state]);
+}
+
+/*
+ * Capture parameters: the level can move while armed, the others are only
+ * taken at the next arming and are fixed while the capture is running.
+ */
+static ssize_t ads1015_capture_param_show(struct device *dev,
+										  struct device_attribute *attr,
+										  char *buf)
+{
+	struct ads1015_data *data = iio_priv(dev_to_iio_dev(dev));
+	struct ads1015_capture *c = &data->capture;
+	int val;
+
+	switch (to_iio_dev_attr(attr)->address)
+	{
+	case 0:
+		val = c->chan;
+		break;
+	case 1:
+		val = c->level;
+		break;
+	case 2:
+		val = c->pre;
+		break;
+	default:
+		val = c->post;
+		break;
+	}
+
+	return sprintf(buf, "%d\n", val);
+}
+
+static ssize_t ads1015_capture_param_store(struct device *dev,
+										   struct device_attribute *attr,
+										   const char *buf, size_t len)
+{
+	struct ads1015_data *data = iio_priv(dev_to_iio_dev(dev));
+	struct ads1015_capture *c = &data->capture;
+	u64 addr = to_iio_dev_attr(attr)->address;
+	int ret, val;
+
+	ret = kstrtoint(buf, 10, &val);
+	if (ret)
+		return ret;
+
+	mutex_lock(&data->lock);
+	if (addr != 1 && c->state != ADS1015_CAPTURE_IDLE)
+	{
+		ret = -EBUSY;
+		goto out;
+	}
+
+	switch (addr)
+	{
+	case 0:
+		if (val < 0 || val >= ADS1015_CHANNELS)
+			ret = -EINVAL;
+		else
+			c->chan = val;
+		break;
+	case 1:
+		c->level = val;
+		break;
+	case 2:
+		if (val < 0 || val + c->post > ADS1015_CAPTURE_MAX)
+			ret = -EINVAL;
+		else
+			c->pre = val;
+		break;
+	default:
+		if (val < 1 || c->pre + val > ADS1015_CAPTURE_MAX)
+			ret = -EINVAL;
+		else
+			c->post = val;
+		break;
+	}
+out:
+	mutex_unlock(&data->lock);
+
+	return ret ? ret : len;
+}
+
+/* pre + post records, the trigger one at index pre, once done */
+static ssize_t ads1015_capture_read(struct file *filp, struct kobject *kobj,
+									struct bin_attribute *attr, char *buf,
+									loff_t off, size_t count)
+{
+	struct iio_dev *indio_dev = dev_to_iio_dev(kobj_to_dev(kobj));
+	struct ads1015_data *data = iio_priv(indio_dev);
+	struct ads1015_capture *c = &data->capture;
+	size_t size, pos, n;
+	u8 *ring;
+
+	mutex_lock(&data->lock);
+	if (c->state != ADS1015_CAPTURE_DONE)
+	{
+		mutex_unlock(&data->lock);
+		return -EBUSY;
+	}
+
+	size = (c->pre + c->post) * sizeof(*c->ring);
+	if (off >= size)
+	{
+		mutex_unlock(&data->lock);
+		return 0;
+	}
+
+	/* the oldest record sits at head once the ring is frozen */
+	ring = (u8 *)c->ring;
+	count = min_t(size_t, count, size - off);
+	pos = (c->head * sizeof(*c->ring) + off) % size;
+	n = min(count, size - pos);
+	memcpy(buf, ring + pos, n);
+	memcpy(buf + n, ring, count - n);
+	mutex_unlock(&data->lock);
+
+	return count;
+}
+
+static struct bin_attribute ads1015_capture_attr = {
+	.attr = {
+		.name = "capture",
+		.mode = 0444,
+	},
+	.read = ads1015_capture_read,
+};
+
+static IIO_DEVICE_ATTR(capture_mode, 0644, ads1015_capture_mode_show,
+					   ads1015_capture_mode_store, 0);
+static IIO_DEVICE_ATTR(capture_mode_available, 0444,
+					   ads1015_capture_mode_available_show, NULL, 0);
+static IIO_DEVICE_ATTR(capture_state, 0444, ads1015_capture_state_show,
+					   NULL, 0);
+static IIO_DEVICE_ATTR(capture_channel, 0644, ads1015_capture_param_show,
+					   ads1015_capture_param_store, 0);
+static IIO_DEVICE_ATTR(capture_level, 0644, ads1015_capture_param_show,
+					   ads1015_capture_param_store, 1);
+static IIO_DEVICE_ATTR(capture_pre, 0644, ads1015_capture_param_show,
+					   ads1015_capture_param_store, 2);
+static IIO_DEVICE_ATTR(capture_post, 0644, ads1015_capture_param_show,
+					   ads1015_capture_param_store, 3);
+
+/* stop the burst capture, data->lock held. As ads1015_acq_put() */
+static bool ads1015_burst_stop(struct ads1015_data *data)
+{
+	struct ads1015_burst *b = &data->burst;
+	bool stop = false;
+
+	if (b->held)
+		stop = ads1015_acq_put(data);
+
+	/* a mapping keeps its pages until unmapped */
+	b->held = false;
+	b->state = ADS1015_BURST_IDLE;
+	vfree(b->mem);
+	b->mem = NULL;
+
+	return stop;
+}
+
+static ssize_t ads1015_burst_en_show(struct device *dev,
+									 struct device_attribute *attr, char *buf)
+{
+	struct ads1015_data *data = iio_priv(dev_to_iio_dev(dev));
+
+	return sprintf(buf, "%d\n", data->burst.state != ADS1015_BURST_IDLE);
+}
+
+/* 1 (re)starts the burst, dropping unread blocks, 0 stops it */
+static ssize_t ads1015_burst_en_store(struct device *dev,
+									  struct device_attribute *attr,
+									  const char *buf, size_t len)
+{
+	struct ads1015_data *data = iio_priv(dev_to_iio_dev(dev));
+	struct ads1015_burst *b = &data->burst;
+	unsigned int size = 0;
+	s16 *mem = NULL;
+	bool en, stop;
+	int ret;
+
+	ret = kstrtobool(buf, &en);
+	if (ret)
+		return ret;
+
+	/*
+	 * The whole ring up front, nothing is allocated while capturing, and
+	 * not under data->lock, the acquisition would wait for it.
+	 */
+	if (en)
+	{
+		size = READ_ONCE(b->ring) * READ_ONCE(b->length);
+		mem = vmalloc_user(size * sizeof(*mem));
+		if (!mem)
+			return -ENOMEM;
+	}
+
+	mutex_lock(&data->lock);
+	stop = ads1015_burst_stop(data);
+	if (!en)
+		goto out;
+
+	/* the ring was resized in between */
+	if (b->ring * b->length != size)
+	{
+		ret = -EAGAIN;
+		goto out;
+	}
+
+	ret = ads1015_acq_get(data, BIT(b->chan), false);
+	if (ret < 0)
+		goto out;
+
+	b->mem = mem;
+	mem = NULL;
+	b->state = ADS1015_BURST_RUNNING;
+	b->held = true;
+	b->head = 0;
+	b->tail = 0;
+	b->fill = 0;
+	b->missed = 0;
+out:
+	mutex_unlock(&data->lock);
+
+	vfree(mem);
+	if (stop)
+		ads1015_acq_release(data);
+
+	ads1015_notify(data, ADS1015_NOTIFY_BURST_STATE);
+	ads1015_notify(data, ADS1015_NOTIFY_BURST_READY);
+
+	return ret < 0 ? ret : len;
+}
+
+static ssize_t ads1015_burst_state_show(struct device *dev,
+										struct device_attribute *attr,
+										char *buf)
+{
+	struct ads1015_data *data = iio_priv(dev_to_iio_dev(dev));
+
+	return sprintf(buf, "%s\n", ads1015_burst_state_names[data->burst.state]);
+}
+
+/* blocks complete and not read yet, then conversions missed since start */
+static ssize_t ads1015_burst_count_show(struct device *dev,
+										struct device_attribute *attr,
+										char *buf)
+{
+	struct ads1015_data *data = iio_priv(dev_to_iio_dev(dev));
+	struct ads1015_burst *b = &data->burst;
+	unsigned int val;
+
+	mutex_lock(&data->lock);
+	if (to_iio_dev_attr(attr)->address)
+		val = b->missed;
+	else
+		val = b->head - b->tail;
+	mutex_unlock(&data->lock);
+
+	return sprintf(buf, "%u\n", val);
+}
+
+/* burst parameters, only taken at the next start */
+static ssize_t ads1015_burst_param_show(struct device *dev,
+										struct device_attribute *attr,
+										char *buf)
+{
+	struct ads1015_data *data = iio_priv(dev_to_iio_dev(dev));
+	struct ads1015_burst *b = &data->burst;
+	unsigned int val;
+
+	switch (to_iio_dev_attr(attr)->address)
+	{
+	case 0:
+		val = b->chan;
+		break;
+	case 1:
+		val = b->length;
+		break;
+	case 2:
+		val = b->blocks;
+		break;
+	default:
+		val = b->ring;
+		break;
+	}
+
+	return sprintf(buf, "%u\n", val);
+}
+
+static ssize_t ads1015_burst_param_store(struct device *dev,
+										 struct device_attribute *attr,
+										 const char *buf, size_t len)
+{
+	struct ads1015_data *data = iio_priv(dev_to_iio_dev(dev));
+	struct ads1015_burst *b = &data->burst;
+	unsigned int val;
+	int ret;
+
+	ret = kstrtouint(buf, 10, &val);
+	if (ret)
+		return ret;
+
+	mutex_lock(&data->lock);
+	if (b->state != ADS1015_BURST_IDLE)
+	{
+		ret = -EBUSY;
+		goto out;
+	}
+
+	switch (to_iio_dev_attr(attr)->address)
+	{
+	case 0:
+		if (val >= ADS1015_CHANNELS)
+			ret = -EINVAL;
+		else
+			b->chan = val;
+		break;
+	case 1:
+		if (val < 1 || val > ADS1015_BURST_MAX)
+			ret = -EINVAL;
+		else
+			b->length = val;
+		break;
+	case 2:
+		b->blocks = val;
+		break;
+	default:
+		if (val < 2 || val > ADS1015_BURST_RING_MAX)
+			ret = -EINVAL;
+		else
+			b->ring = val;
+		break;
+	}
+out:
+	mutex_unlock(&data->lock);
+
+	return ret ? ret : len;
+}
+
+/*
+ * The oldest complete block, length s16 in in_voltageN_raw units. Reading
+ * its last byte hands it back to the acquisition.
+ */
+static ssize_t ads1015_burst_read(struct file *filp, struct kobject *kobj,
+								  struct bin_attribute *attr, char *buf,
+								  loff_t off, size_t count)
+{
+	struct iio_dev *indio_dev = dev_to_iio_dev(kobj_to_dev(kobj));
+	struct ads1015_data *data = iio_priv(indio_dev);
+	struct ads1015_burst *b = &data->burst;
+	size_t size;
+	ssize_t ret;
+
+	mutex_lock(&data->lock);
+	if (b->state == ADS1015_BURST_IDLE)
+	{
+		ret = -EBUSY;
+		goto out;
+	}
+
+	size = b->length * sizeof(*b->mem);
+	if (off >= size)
+	{
+		ret = 0;
+		goto out;
+	}
+
+	if (b->head == b->tail)
+	{
+		ret = -EAGAIN;
+		goto out;
+	}
+
+	count = min_t(size_t, count, size - off);
+	memcpy(buf, (u8 *)(b->mem + (b->tail % b->ring) * b->length) + off,
+		   count);
+	if (off + count == size)
+	{
+		b->tail++;
+		ads1015_notify(data, ADS1015_NOTIFY_BURST_READY);
+	}
+	ret = count;
+out:
+	mutex_unlock(&data->lock);
+
+	return ret;
+}
+
+/* the whole ring, block k at k * burst_length samples */
+static int ads1015_burst_mmap(struct file *filp, struct kobject *kobj,
+							  struct bin_attribute *attr,
+							  struct vm_area_struct *vma)
+{
+	struct iio_dev *indio_dev = dev_to_iio_dev(kobj_to_dev(kobj));
+	struct ads1015_data *data = iio_priv(indio_dev);
+	int ret;
+
+	mutex_lock(&data->lock);
+	if (data->burst.state == ADS1015_BURST_IDLE)
+		ret = -EBUSY;
+	else
+		ret = remap_vmalloc_range(vma, data->burst.mem, vma->vm_pgoff);
+	mutex_unlock(&data->lock);
+
+	return ret;
+}
+
+/*
+ * Mapped ring: reading gives the index of the oldest complete block (with
+ * burst_ready non-zero), writing that index back hands it over again.
+ */
+static ssize_t ads1015_burst_block_show(struct device *dev,
+										struct device_attribute *attr,
+										char *buf)
+{
+	struct ads1015_data *data = iio_priv(dev_to_iio_dev(dev));
+	struct ads1015_burst *b = &data->burst;
+	int val = -1;
+
+	mutex_lock(&data->lock);
+	if (b->state != ADS1015_BURST_IDLE && b->head != b->tail)
+		val = b->tail % b->ring;
+	mutex_unlock(&data->lock);
+
+	return sprintf(buf, "%d\n", val);
+}
+
+static ssize_t ads1015_burst_block_store(struct device *dev,
+										 struct device_attribute *attr,
+										 const char *buf, size_t len)
+{
+	struct ads1015_data *data = iio_priv(dev_to_iio_dev(dev));
+	struct ads1015_burst *b = &data->burst;
+	unsigned int val;
+	int ret;
+
+	ret = kstrtouint(buf, 10, &val);
+	if (ret)
+		return ret;
+
+	mutex_lock(&data->lock);
+	if (b->state == ADS1015_BURST_IDLE || b->head == b->tail ||
+		val != b->tail % b->ring)
+	{
+		ret = -EINVAL;
+	}
+	else
+	{
+		b->tail++;
+		ads1015_notify(data, ADS1015_NOTIFY_BURST_READY);
+	}
+	mutex_unlock(&data->lock);
+
+	return ret ? ret : len;
+}
+
+static struct bin_attribute ads1015_burst_attr = {
+	.attr = {
+		.name = "burst",
+		.mode = 0444,
+	},
+	.read = ads1015_burst_read,
+	.mmap = ads1015_burst_mmap,
+};
+
+static struct bin_attribute *ads1015_bin_attrs[] = {
+	&ads1015_capture_attr,
+	&ads1015_burst_attr,
+	NULL,
+};
+
+static const struct attribute_group ads1015_bin_group = {
+	.bin_attrs = ads1015_bin_attrs,
+};
+
+static IIO_DEVICE_ATTR(burst_en, 0644, ads1015_burst_en_show,
+					   ads1015_burst_en_store, 0);
+static IIO_DEVICE_ATTR(burst_state, 0444, ads1015_burst_state_show, NULL, 0);
+static IIO_DEVICE_ATTR(burst_ready, 0444, ads1015_burst_count_show, NULL, 0);
+static IIO_DEVICE_ATTR(burst_missed, 0444, ads1015_burst_count_show, NULL, 1);
+static IIO_DEVICE_ATTR(burst_channel, 0644, ads1015_burst_param_show,
+					   ads1015_burst_param_store, 0);
+static IIO_DEVICE_ATTR(burst_length, 0644, ads1015_burst_param_show,
+					   ads1015_burst_param_store, 1);
+static IIO_DEVICE_ATTR(burst_blocks, 0644, ads1015_burst_param_show,
+					   ads1015_burst_param_store, 2);
+static IIO_DEVICE_ATTR(burst_ring_blocks, 0644, ads1015_burst_param_show,
+					   ads1015_burst_param_store, 3);
+static IIO_DEVICE_ATTR(burst_block, 0644, ads1015_burst_block_show,
+					   ads1015_burst_block_store, 0);
+
+static ssize_t ads1015_decimation_show(struct device *dev,
+									   struct device_attribute *attr,
+									   char *buf)
+{
+	struct ads1015_stream *stream = ads1015_to_stream(dev_to_iio_dev(dev));
+
+	return sprintf(buf, "%u\n", stream->decimation);
+}
+
+static ssize_t ads1015_decimation_store(struct device *dev,
+										struct device_attribute *attr,
+										const char *buf, size_t len)
+{
+	struct ads1015_stream *stream = ads1015_to_stream(dev_to_iio_dev(dev));
+	struct ads1015_data *data = stream->data;
+	unsigned int val;
+	int ret;
+
+	ret = kstrtouint(buf, 10, &val);
+	if (ret)
+		return ret;
+
+	if (val < 1 || val > ADS1015_MAX_DECIMATION)
+		return -EINVAL;
+
+	mutex_lock(&data->lock);
+	stream->decimation = val;
+	/* restart the average, a partial one would mix both factors */
+	ads1015_stream_reset(stream);
+	mutex_unlock(&data->lock);
+
+	return len;
+}
+
+/* "<first sequence number> <scale> <sampling frequency>" of the scan */
+static IIO_DEVICE_ATTR(scan_config, 0444, ads1015_scan_config_show, NULL, 0);
+
+/* conversions averaged into one scan of this device's buffer */
+static IIO_DEVICE_ATTR(decimation, 0644, ads1015_decimation_show,
+					   ads1015_decimation_store, 0);
+
+/* "<scan index> <timestamp ns> <sample period ns>" */
+static IIO_DEVICE_ATTR(timestamp_ref, 0444, ads1015_timestamp_ref_show,
+					   NULL, 0);
+static IIO_DEVICE_ATTR(timestamp_ref_interval, 0644,
+					   ads1015_timestamp_ref_interval_show,
+					   ads1015_timestamp_ref_interval_store, 0);
+
+static IIO_DEVICE_ATTR(atomic_conv_read, 0444, ads1015_atomic_conv_read_show,
+					   NULL, 0);
+static IIO_DEVICE_ATTR(atomic_batch, 0644, ads1015_atomic_batch_show,
+					   ads1015_atomic_batch_store, 0);
+static IIO_DEVICE_ATTR(atomic_overruns, 0444, ads1015_atomic_overruns_show,
+					   NULL, 0);
+
+static IIO_DEVICE_ATTR(irq_priority, 0644, ads1015_irq_priority_show,
+					   ads1015_irq_priority_store, 0);
+static IIO_DEVICE_ATTR(irq_affinity, 0644, ads1015_irq_affinity_show,
+					   ads1015_irq_affinity_store, 0);
+
+static IIO_CONST_ATTR_NAMED(ads1015_scale_available, scale_available,
+							"3 2 1 0.5 0.25 0.125");
+static IIO_CONST_ATTR_NAMED(ads1115_scale_available, scale_available,
+							"0.1875 0.125 0.0625 0.03125 0.015625 0.007813");
+
+static IIO_CONST_ATTR_NAMED(ads1015_sampling_frequency_available,
+							sampling_frequency_available, "128 250 490 920 1600 2400 3300");
+static IIO_CONST_ATTR_NAMED(ads1115_sampling_frequency_available,
+							sampling_frequency_available, "8 16 32 64 128 250 475 860");
+
+static struct attribute *ads1015_attributes[] = {
+	&iio_const_attr_ads1015_scale_available.dev_attr.attr,
+	&iio_const_attr_ads1015_sampling_frequency_available.dev_attr.attr,
+	&iio_dev_attr_cache_max_age_us.dev_attr.attr,
+	&iio_dev_attr_error_state.dev_attr.attr,
+	&iio_dev_attr_error_count.dev_attr.attr,
+	&iio_dev_attr_watchdog_count.dev_attr.attr,
+	&iio_dev_attr_irq_storm.dev_attr.attr,
+	&iio_dev_attr_latency.dev_attr.attr,
+	&iio_dev_attr_sched_overruns.dev_attr.attr,
+	&iio_dev_attr_irq_priority.dev_attr.attr,
+	&iio_dev_attr_irq_affinity.dev_attr.attr,
+	&iio_dev_attr_atomic_conv_read.dev_attr.attr,
+	&iio_dev_attr_atomic_batch.dev_attr.attr,
+	&iio_dev_attr_atomic_overruns.dev_attr.attr,
+	&iio_dev_attr_timestamp_ref.dev_attr.attr,
+	&iio_dev_attr_timestamp_ref_interval.dev_attr.attr,
+	&iio_dev_attr_decimation.dev_attr.attr,
+	&iio_dev_attr_scan_config.dev_attr.attr,
+	&iio_dev_attr_capture_mode.dev_attr.attr,
+	&iio_dev_attr_capture_mode_available.dev_attr.attr,
+	&iio_dev_attr_capture_state.dev_attr.attr,
+	&iio_dev_attr_capture_channel.dev_attr.attr,
+	&iio_dev_attr_capture_level.dev_attr.attr,
+	&iio_dev_attr_capture_pre.dev_attr.attr,
+	&iio_dev_attr_capture_post.dev_attr.attr,
+	&iio_dev_attr_burst_en.dev_attr.attr,
+	&iio_dev_attr_burst_state.dev_attr.attr,
+	&iio_dev_attr_burst_ready.dev_attr.attr,
+	&iio_dev_attr_burst_missed.dev_attr.attr,
+	&iio_dev_attr_burst_channel.dev_attr.attr,
+	&iio_dev_attr_burst_length.dev_attr.attr,
+	&iio_dev_attr_burst_blocks.dev_attr.attr,
+	&iio_dev_attr_burst_ring_blocks.dev_attr.attr,
+	&iio_dev_attr_burst_block.dev_attr.attr,
+	NULL,
+};
+
+static const struct attribute_group ads1015_attribute_group = {
+	.attrs = ads1015_attributes,
+};
+
+static struct attribute *ads1115_attributes[] = {
+	&iio_const_attr_ads1115_scale_available.dev_attr.attr,
+	&iio_const_attr_ads1115_sampling_frequency_available.dev_attr.attr,
+	&iio_dev_attr_cache_max_age_us.dev_attr.attr,
+	&iio_dev_attr_error_state.dev_attr.attr,
+	&iio_dev_attr_error_count.dev_attr.attr,
+	&iio_dev_attr_watchdog_count.dev_attr.attr,
+	&iio_dev_attr_irq_storm.dev_attr.attr,
+	&iio_dev_attr_latency.dev_attr.attr,
+	&iio_dev_attr_sched_overruns.dev_attr.attr,
+	&iio_dev_attr_irq_priority.dev_attr.attr,
+	&iio_dev_attr_irq_affinity.dev_attr.attr,
+	&iio_dev_attr_atomic_conv_read.dev_attr.attr,
+	&iio_dev_attr_atomic_batch.dev_attr.attr,
+	&iio_dev_attr_atomic_overruns.dev_attr.attr,
+	&iio_dev_attr_timestamp_ref.dev_attr.attr,
+	&iio_dev_attr_timestamp_ref_interval.dev_attr.attr,
+	&iio_dev_attr_decimation.dev_attr.attr,
+	&iio_dev_attr_scan_config.dev_attr.attr,
+	&iio_dev_attr_capture_mode.dev_attr.attr,
+	&iio_dev_attr_capture_mode_available.dev_attr.attr,
+	&iio_dev_attr_capture_state.dev_attr.attr,
+	&iio_dev_attr_capture_channel.dev_attr.attr,
+	&iio_dev_attr_capture_level.dev_attr.attr,
+	&iio_dev_attr_capture_pre.dev_attr.attr,
+	&iio_dev_attr_capture_post.dev_attr.attr,
+	&iio_dev_attr_burst_en.dev_attr.attr,
+	&iio_dev_attr_burst_state.dev_attr.attr,
+	&iio_dev_attr_burst_ready.dev_attr.attr,
+	&iio_dev_attr_burst_missed.dev_attr.attr,
+	&iio_dev_attr_burst_channel.dev_attr.attr,
+	&iio_dev_attr_burst_length.dev_attr.attr,
+	&iio_dev_attr_burst_blocks.dev_attr.attr,
+	&iio_dev_attr_burst_ring_blocks.dev_attr.attr,
+	&iio_dev_attr_burst_block.dev_attr.attr,
+	NULL,
+};
+
+static const struct attribute_group ads1115_attribute_group = {
+	.attrs = ads1115_attributes,
+};
+
+/* our own RDY edge paces the buffer directly, without the trigger */
+static int ads1015_validate_trigger(struct iio_dev *indio_dev,
+									struct iio_trigger *trig)
+{
+	struct ads1015_data *data = iio_priv(indio_dev);
+
+	return trig == data->trig ? -EINVAL : 0;
+}
+
+static const struct iio_info ads1015_info = {
+	.read_raw = ads1015_read_raw,
+	.write_raw = ads1015_write_raw,
+	.validate_trigger = ads1015_validate_trigger,
+	.attrs = &ads1015_attribute_group,
+};
+
+static const struct iio_info ads1115_info = {
+	.read_raw = ads1015_read_raw,
+	.write_raw = ads1015_write_raw,
+	.validate_trigger = ads1015_validate_trigger,
+	.attrs = &ads1115_attribute_group,
+};
+
+/*
+ * Companion devices only carry a buffer: raw reads, scale and sampling
+ * frequency stay on the main device.
+ */
+static struct attribute *ads1015_stream_attributes[] = {
+	&iio_dev_attr_decimation.dev_attr.attr,
+	NULL,
+};
+
+static const struct attribute_group ads1015_stream_attribute_group = {
+	.attrs = ads1015_stream_attributes,
+};
+
+static const struct iio_info ads1015_stream_info = {
+	.attrs = &ads1015_stream_attribute_group,
+};
+
+#ifdef CONFIG_OF
+static int ads1015_get_channels_config_of(struct i2c_client *client)
+{
+	struct iio_dev *indio_dev = i2c_get_clientdata(client);
+	struct ads1015_data *data = iio_priv(indio_dev);
+	struct device_node *node;
+
+	if (!client->dev.of_node ||
+		!of_get_next_child(client->dev.of_node, NULL))
+		return -EINVAL;
+
+	for_each_child_of_node(client->dev.of_node, node)
+	{
+		u32 pval;
+		s32 bias;
+		unsigned int channel;
+		unsigned int pga = ADS1015_DEFAULT_PGA;
+		unsigned int data_rate = ADS1015_DEFAULT_DATA_RATE;
+
+		if (of_property_read_u32(node, "reg", &pval))
+		{
+			dev_err(&client->dev, "invalid reg on %pOF\n",
+					node);
+			continue;
+		}
+
+		channel = pval;
+		if (channel >= ADS1015_CHANNELS)
+		{
+			dev_err(&client->dev,
+					"invalid channel index %d on %pOF\n",
+					channel, node);
+			continue;
+		}
+
+		if (!of_property_read_u32(node, "ti,gain", &pval))
+		{
+			pga = pval;
+			if (pga > 6)
+			{
+				dev_err(&client->dev, "invalid gain on %pOF\n",
+						node);
+				of_node_put(node);
+				return -EINVAL;
+			}
+		}
+
+		if (!of_property_read_u32(node, "ti,datarate", &pval))
+		{
+			data_rate = pval;
+			if (data_rate > 7)
+			{
+				dev_err(&client->dev,
+						"invalid data_rate on %pOF\n",
+						node);
+				of_node_put(node);
+				return -EINVAL;
+			}
+		}
+
+		if (!of_property_read_s32(node, "ti,calibbias", &bias) &&
+			ads1015_set_calibbias(data, &indio_dev->channels[channel],
+								  bias))
+		{
+			dev_err(&client->dev, "invalid calibbias on %pOF\n", node);
+			of_node_put(node);
+			return -EINVAL;
+		}
+
+		/* in millionths, 1000000 for no correction */
+		if (!of_property_read_u32(node, "ti,calibscale", &pval) &&
+			ads1015_set_calibscale(data, channel, 0, pval))
+		{
+			dev_err(&client->dev, "invalid calibscale on %pOF\n", node);
+			of_node_put(node);
+			return -EINVAL;
+		}
+
+		data->channel_data[channel].pga = pga;
+		data->channel_data[channel].data_rate = data_rate;
+		if (of_property_read_bool(node, "ti,autorange"))
+			set_bit(channel, &data->autorange);
+		dev_dbg(&client->dev, "channel=%d pga=%d data_rate=%d", channel, pga, data_rate);
+	}
+
+	return 0;
+}
+
+static int ads1015_get_irq_config_of(struct i2c_client *client)
+{
+	struct iio_dev *indio_dev = i2c_get_clientdata(client);
+	struct ads1015_data *data = iio_priv(indio_dev);
+	struct device_node *node = client->dev.of_node;
+	u32 pval;
+	int k, n;
+
+	if (!node)
+		return 0;
+
+	if (!of_property_read_u32(node, "ti,irq-priority", &pval))
+	{
+		if (pval < 1 || pval >= MAX_RT_PRIO)
+		{
+			dev_err(&client->dev, "invalid ti,irq-priority %u\n", pval);
+			return -EINVAL;
+		}
+		data->irq_priority = pval;
+	}
+
+	data->atomic_read = of_property_read_bool(node, "ti,atomic-conv-read");
+	data->shared_irq = of_property_read_bool(node, "ti,shared-irq");
+
+	n = of_property_count_u32_elems(node, "ti,irq-cpus");
+	if (n <= 0)
+		return 0;
+
+	for (k = 0; k < n; k++)
+	{
+		if (of_property_read_u32_index(node, "ti,irq-cpus", k, &pval) ||
+			pval >= nr_cpu_ids)
+		{
+			dev_err(&client->dev, "invalid ti,irq-cpus on %pOF\n", node);
+			return -EINVAL;
+		}
+		cpumask_set_cpu(pval, &data->irq_cpus);
+	}
+
+	return 0;
+}
+#endif
+
+static void ads1015_get_channels_config(struct i2c_client *client)
+{
+	unsigned int k;
+
+	struct iio_dev *indio_dev = i2c_get_clientdata(client);
+	struct ads1015_data *data = iio_priv(indio_dev);
+	struct ads1015_platform_data *pdata = dev_get_platdata(&client->dev);
+
+	/* prefer platform data */
+	if (pdata)
+	{
+		memcpy(data->channel_data, pdata->channel_data,
+			   sizeof(data->channel_data));
+		return;
+	}
+
+#ifdef CONFIG_OF
+	if (!ads1015_get_channels_config_of(client))
+		return;
+#endif
+	/* fallback on default configuration */
+	for (k = 0; k < ADS1015_CHANNELS; ++k)
+	{
+		data->channel_data[k].pga = ADS1015_DEFAULT_PGA;
+		data->channel_data[k].data_rate = ADS1015_DEFAULT_DATA_RATE;
+	}
+}
+
+static int ads1015_set_conv_ready_pin(struct ads1015_data *data)
+{
+	int ret;
+
+	ret = regmap_write(data->regmap, ADS1015_LO_THRESH_REG, 0);
+	if (ret)
+		return ret;
+
+	ret = regmap_write(data->regmap, ADS1015_HI_THRESH_REG, 0xFFFF);
+	if (ret)
+		return ret;
+
+	return regmap_update_bits(data->regmap, ADS1015_CFG_REG, ADS1015_CFG_COMP_QUE_MASK, 0);
+}
+
+/*
+ * Hard IRQ context: read CONV with the adapter's atomic transfer unless our
+ * process context is on the bus, then the thread reads it. Returns true if
+ * the thread need not run.
+ */
+static bool ads1015_atomic_conv_read(struct ads1015_data *data, u32 seq,
+									 s64 timestamp)
+{
+	struct i2c_client *client = to_i2c_client(regmap_get_device(data->regmap));
+	struct i2c_adapter *adap = client->adapter;
+	unsigned int head, tail;
+	bool handled = false;
+	u8 reg = ADS1015_CONV_REG;
+	u8 rx[2];
+	struct i2c_msg msgs[] = {
+		{
+			.addr = client->addr,
+			.len = 1,
+			.buf = &reg,
+		},
+		{
+			.addr = client->addr,
+			.flags = I2C_M_RD,
+			.len = sizeof(rx),
+			.buf = rx,
+		},
+	};
+	int ret;
+
+	raw_spin_lock(&data->atomic_lock);
+	data->edge_read = false;
+	if (data->bus_users || !data->atomic_on)
+		goto out;
+
+	ret = adap->algo->master_xfer_atomic(adap, msgs, ARRAY_SIZE(msgs));
+	if (ret != ARRAY_SIZE(msgs))
+	{
+		data->atomic_err = ret < 0 ? ret : -EIO;
+		goto out;
+	}
+
+	head = data->ring_head;
+	tail = smp_load_acquire(&data->ring_tail);
+	if (head - tail >= ADS1015_RING_SIZE)
+	{
+		data->ring_overruns++;
+		goto out;
+	}
+
+	data->ring[head & (ADS1015_RING_SIZE - 1)].val = rx[0] << 8 | rx[1];
+	data->ring[head & (ADS1015_RING_SIZE - 1)].seq = seq;
+	data->ring[head & (ADS1015_RING_SIZE - 1)].timestamp = timestamp;
+	smp_store_release(&data->ring_head, head + 1);
+	data->edge_read = true;
+
+	/* wake the thread for a full batch or a pending one-off read */
+	handled = head + 1 - tail < data->atomic_batch &&
+			  READ_ONCE(data->oneshot_chan) < 0;
+out:
+	raw_spin_unlock(&data->atomic_lock);
+
+	return handled;
+}
+
+static bool ads1015_ring_get(struct ads1015_data *data,
+							 struct ads1015_raw_sample *sample)
+{
+	unsigned int tail = data->ring_tail;
+
+	if (tail == smp_load_acquire(&data->ring_head))
+		return false;
+
+	*sample = data->ring[tail & (ADS1015_RING_SIZE - 1)];
+	smp_store_release(&data->ring_tail, tail + 1);
+
+	return true;
+}
+
+/*
+ * Hard IRQ context: count the edge against the nominal conversion rate and
+ * mask the line on a storm. Returns true if the edge is to be ignored.
+ */
+static bool ads1015_storm_check(struct ads1015_data *data)
+{
+	s64 now = ktime_get_ns();
+	s64 period = READ_ONCE(data->edge_period_ns);
+
+	if (period != data->storm_period ||
+		now - data->storm_start >= ADS1015_STORM_PERIODS * period)
+	{
+		/* a whole window at a sane rate ends a series of storms */
+		if (period == data->storm_period)
+		{
+			data->storm_retries = 0;
+			data->storm_delay_ms = ADS1015_STORM_MIN_DELAY_MS;
+		}
+		data->storm_period = period;
+		data->storm_start = now;
+		data->storm_edges = 0;
+	}
+
+	if (++data->storm_edges <= ADS1015_STORM_PERIODS * ADS1015_STORM_FACTOR)
+		return false;
+
+	disable_irq_nosync(data->irq);
+	data->storm_count++;
+	data->storm_retries++;
+	WRITE_ONCE(data->storm_state, ADS1015_STORM_THROTTLED);
+	schedule_delayed_work(&data->storm_work,
+						  msecs_to_jiffies(data->storm_delay_ms));
+
+	return true;
+}
+
+/* the line stayed masked for storm_delay_ms: unmask it, or start polling */
+static void ads1015_storm_work(struct work_struct *work)
+{
+	struct ads1015_data *data = container_of(to_delayed_work(work),
+											 struct ads1015_data,
+											 storm_work);
+	struct device *dev = regmap_get_device(data->regmap);
+	s64 period = READ_ONCE(data->edge_period_ns);
+
+	ads1015_notify(data, ADS1015_NOTIFY_IRQ_STORM);
+
+	if (data->storm_retries >= ADS1015_STORM_RETRIES)
+	{
+		dev_warn(dev, "irq %d storm persists, polling every %lld ns\n",
+				 data->irq, period);
+		WRITE_ONCE(data->storm_state, ADS1015_STORM_POLLING);
+		hrtimer_start(&data->poll_timer, ns_to_ktime(period),
+					  HRTIMER_MODE_REL);
+		return;
+	}
+
+	dev_warn(dev, "irq %d storm, line masked for %u ms\n", data->irq,
+			 data->storm_delay_ms);
+	data->storm_delay_ms = min(2 * data->storm_delay_ms,
+							   (unsigned int)ADS1015_STORM_MAX_DELAY_MS);
+	data->storm_start = ktime_get_ns();
+	data->storm_edges = 0;
+	WRITE_ONCE(data->storm_state, ADS1015_STORM_NONE);
+	enable_irq(data->irq);
+}
+
+static irqreturn_t __attribute__((optimize("O0"))) ads1015_irq_handler(int irq, void *private)
+{
+	struct iio_dev *indio_dev = private;
+	struct ads1015_data *data = iio_priv(indio_dev);
+	s64 timestamp;
+	u32 seq;
+
+	/* a shared line is checked by none of its members */
+	if (!data->group &&
+		READ_ONCE(data->storm_state) == ADS1015_STORM_NONE &&
+		ads1015_storm_check(data))
+		return IRQ_HANDLED;
+
+	timestamp = iio_get_time_ns(indio_dev);
+	seq = atomic_inc_return(&data->irq_count);
+	atomic_inc(&data->edge_count);
+
+	/* other devices sampling in lockstep with the conversions */
+	if (READ_ONCE(data->trig_enabled))
+		iio_trigger_poll(data->trig);
+
+	/* end of a triggered or scheduled single-shot conversion */
+	if (READ_ONCE(data->single_shot))
+	{
+		data->timestamp = timestamp;
+		data->seq = seq;
+		complete(&data->conv_done);
+		return IRQ_HANDLED;
+	}
+
+	/* every buffer is full and waiting for its reader */
+	if (ads1015_paused(data))
+		return IRQ_HANDLED;
+
+	/* once the thread has programmed the scan channel */
+	data->edge_read = false;
+	if (READ_ONCE(data->atomic_on) && READ_ONCE(data->use_buffer) &&
+		ads1015_atomic_conv_read(data, seq, timestamp))
+		return IRQ_HANDLED;
+
+	/* no buffer of ours is running, nothing for the thread to read */
+	if (!READ_ONCE(data->active_streams))
+		return IRQ_HANDLED;
+
+	data->timestamp = timestamp;
+	data->seq = seq;
+	return IRQ_WAKE_THREAD;
+}
+
+/* stands in for the masked line after a persistent storm */
+static enum hrtimer_restart ads1015_poll_fn(struct hrtimer *timer)
+{
+	struct ads1015_data *data = container_of(timer, struct ads1015_data,
+											 poll_timer);
+
+	if (ads1015_irq_handler(data->irq, iio_priv_to_dev(data)) ==
+		IRQ_WAKE_THREAD)
+		ads1015_wake_thread(data);
+
+	hrtimer_forward_now(timer, ns_to_ktime(READ_ONCE(data->edge_period_ns)));
+
+	return HRTIMER_RESTART;
+}
+
+/*
+ * Called from the acquisition thread with data->lock held. Never blocks on
+ * the bus: the IRQ is masked and the recovery runs from a work item.
+ */
+static void ads1015_report_error(struct ads1015_data *data, int err)
+{
+	data->error_count++;
+	if (data->state != ADS1015_STATE_OK)
+		return;
+
+	data->last_error = err;
+	data->state = ADS1015_STATE_RECOVERING;
+	data->recover_delay_ms = ADS1015_RECOVERY_MIN_DELAY_MS;
+	data->recover_attempts = 0;
+	/* a shared line keeps serving the others, edges are not claimed */
+	if (data->irq > 0 && !data->group)
+		disable_irq_nosync(data->irq);
+	schedule_delayed_work(&data->recover_work,
+						  msecs_to_jiffies(data->recover_delay_ms));
+	ads1015_notify(data, ADS1015_NOTIFY_ERROR_STATE);
+}
+
+static void ads1015_recover_work(struct work_struct *work)
+{
+	struct ads1015_data *data = container_of(to_delayed_work(work),
+											 struct ads1015_data,
+											 recover_work);
+	struct device *dev = regmap_get_device(data->regmap);
+	struct i2c_adapter *adap = to_i2c_client(dev)->adapter;
+	int ret;
+
+	/*
+	 * Without data->lock: the acquisition leaves the chip alone until the
+	 * state is OK again, and regmap serializes the other register users.
+	 * A stuck slave may hold SDA low, clock it out if the adapter can.
+	 */
+	ads1015_bus_claim(data);
+	i2c_lock_bus(adap, I2C_LOCK_ROOT_ADAPTER);
+	ret = i2c_recover_bus(adap);
+	i2c_unlock_bus(adap, I2C_LOCK_ROOT_ADAPTER);
+	ads1015_bus_release(data);
+	if (ret && ret != -EOPNOTSUPP)
+		dev_dbg(dev, "bus recovery ret=%d", ret);
+
+	/* rewrite CFG and thresholds, this also restarts the conversion */
+	regcache_mark_dirty(data->regmap);
+	ret = regcache_sync(data->regmap);
+
+	mutex_lock(&data->lock);
+	if (ret && ++data->recover_attempts >= ADS1015_RECOVERY_MAX_ATTEMPTS)
+	{
+		/* the device is gone, the next acquisition start tries again */
+		data->state = ADS1015_STATE_FAILED;
+		mutex_unlock(&data->lock);
+		dev_err(dev, "giving up recovery, register restore ret=%d\n", ret);
+		sysfs_notify(&iio_priv_to_dev(data)->dev.kobj, NULL, "error_state");
+		return;
+	}
+	if (ret)
+	{
+		data->recover_delay_ms = min(2 * data->recover_delay_ms,
+									 (unsigned int)ADS1015_RECOVERY_MAX_DELAY_MS);
+		dev_dbg(dev, "register restore ret=%d, retry in %u ms", ret,
+				data->recover_delay_ms);
+		schedule_delayed_work(&data->recover_work,
+							  msecs_to_jiffies(data->recover_delay_ms));
+		mutex_unlock(&data->lock);
+		return;
+	}
+
+	/* the conversion in flight was started before the restore */
+	data->conv_skip = 1;
+	data->conv_invalid = true;
+	data->recover_count++;
+	data->state = ADS1015_STATE_OK;
+	if (data->irq > 0 && !data->group)
+		enable_irq(data->irq);
+	if (data->sched_on)
+		queue_work(system_highpri_wq, &data->sched_work);
+
+	mutex_unlock(&data->lock);
+
+	dev_info(dev, "recovered from i2c error\n");
+	sysfs_notify(&iio_priv_to_dev(data)->dev.kobj, NULL, "error_state");
+}
+
+static void ads1015_cancel_recovery(void *data)
+{
+	struct ads1015_data *adata = data;
+
+	hrtimer_cancel(&adata->watchdog);
+	cancel_delayed_work_sync(&adata->recover_work);
+	hrtimer_cancel(&adata->sched_timer);
+	cancel_work_sync(&adata->sched_work);
+	cancel_delayed_work_sync(&adata->storm_work);
+	hrtimer_cancel(&adata->poll_timer);
+	cancel_work_sync(&adata->done_work);
+	cancel_work_sync(&adata->notify_work);
+}
+
+/*
+ * Runs in the IRQ thread, the scheduler calls only target current here.
+ * sched_setscheduler_nocheck() is no longer exported from 5.9 on.
+ */
+static void ads1015_apply_irq_priority(struct ads1015_data *data)
+{
+	struct device *dev = regmap_get_device(data->regmap);
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(5, 9, 0)
+	struct sched_attr attr = {
+		.size = sizeof(attr),
+		.sched_policy = SCHED_FIFO,
+		.sched_priority = data->irq_priority,
+	};
+#else
+	struct sched_param param = {
+		.sched_priority = data->irq_priority,
+	};
+#endif
+	int ret;
+
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(5, 9, 0)
+	ret = sched_setattr_nocheck(current, &attr);
+#else
+	ret = sched_setscheduler_nocheck(current, SCHED_FIFO, &param);
+#endif
+	if (ret)
+		dev_warn(dev, "failed to set irq thread priority %u: %d\n",
+				 data->irq_priority, ret);
+}
+
+/* record the reference of the sparse timestamps, data->lock held */
+static void ads1015_update_ts_ref(struct ads1015_data *data, u32 seq,
+								  s64 timestamp)
+{
+	if (!data->push_count)
+	{
+		data->ts_first_seq = seq;
+		data->ts_first = timestamp;
+	}
+
+	if (!data->ts_ref_countdown)
+	{
+		data->ts_ref_seq = seq;
+		data->ts_ref = timestamp;
+		data->ts_ref_countdown = data->ts_ref_interval;
+	}
+
+	data->ts_ref_countdown--;
+	data->push_count++;
+}
+
+/*
+ * Pick the range of the captured input from its recent results: wider as
+ * soon as one gets close to full scale, narrower once a whole window would
+ * fit. The new PGA is applied like a live scale change. data->lock held.
+ */
+static void ads1015_autorange(struct ads1015_data *data, int chan, int res)
+{
+	int mag = abs((s16)res);
+	int old = data->channel_data[chan].pga;
+	int pga = min(old, ADS1015_AUTORANGE_PGA_MAX);
+
+	/* wait for the previous step to settle */
+	if (data->cfg_pending)
+		return;
+
+	data->autorange_peak[chan] = max(data->autorange_peak[chan], mag);
+
+	if (mag >= ADS1015_AUTORANGE_HIGH)
+	{
+		if (pga > 0)
+			pga--;
+	}
+	else if (++data->autorange_count[chan] < ADS1015_AUTORANGE_WINDOW)
+	{
+		return;
+	}
+	else if (data->autorange_peak[chan] < ADS1015_AUTORANGE_LOW &&
+			 pga < ADS1015_AUTORANGE_PGA_MAX)
+	{
+		pga++;
+	}
+
+	data->autorange_peak[chan] = 0;
+	data->autorange_count[chan] = 0;
+
+	if (pga == old)
+		return;
+
+	data->channel_data[chan].pga = pga;
+	data->cache[chan].valid = false;
+	data->cfg_pending = true;
+}
+
+/*
+ * Push a result of input @idx: averaged into the stream, a scan goes out
+ * every decimation results, time-stamped in the middle of the averaged
+ * interval. Returns 0 once pushed, 1 when it goes in no scan of this buffer
+ * (input not in its scan mask, decimated scan still being accumulated), or
+ * the push error. data->lock held.
+ */
+static int ads1015_stream_push(struct ads1015_stream *stream, int idx,
+							   int res, u32 seq, s64 timestamp)
+{
+	struct iio_dev *indio_dev = stream->indio_dev;
+	struct ads1015_data *data = stream->data;
+	struct iio_chan_spec const *chan = &indio_dev->channels[idx];
+	struct ads1015_stats *acc = &stream->acc[idx];
+	int pga = data->conv_pga;
+	int min, max, rms, k;
+	size_t offset;
+
+	/* a buffer joined on a part of the scheduled inputs */
+	if (!test_bit(idx, indio_dev->active_scan_mask))
+		return 1;
+
+	if (stream->decimation > 1)
+	{
+		if (!acc->count)
+			stream->ts_first[idx] = timestamp;
+
+		ads1015_stats_add(acc, (s16)res);
+		if (acc->count < stream->decimation)
+			return 1;
+
+		res = (s16)ads1015_stats_mean(acc);
+		min = acc->min;
+		max = acc->max;
+		rms = ads1015_stats_rms(acc);
+		timestamp = stream->ts_first[idx] +
+					(timestamp - stream->ts_first[idx]) / 2;
+		ads1015_stats_reset(acc);
+	}
+	else
+	{
+		min = (s16)res;
+		max = (s16)res;
+		rms = abs((s16)res);
+	}
+
+	/*
+	 * Elements in scan index order at their natural alignment, the other
+	 * inputs keep their last sample.
+	 */
+	offset = 0;
+	for_each_set_bit(k, indio_dev->active_scan_mask, ADS1015_CHANNELS)
+	{
+		if (k == idx)
+			*(s16 *)(stream->scan + offset) = res;
+		offset += sizeof(s16);
+	}
+	if (test_bit(ADS1015_RANGE, indio_dev->active_scan_mask))
+	{
+		*(u16 *)(stream->scan + offset) = ads1015_fullscale_range[pga];
+		offset += sizeof(u16);
+	}
+	if (test_bit(ADS1015_SOURCE, indio_dev->active_scan_mask))
+	{
+		*(u16 *)(stream->scan + offset) = idx;
+		offset += sizeof(u16);
+	}
+	if (test_bit(ADS1015_PROCESSED, indio_dev->active_scan_mask))
+	{
+		offset = ALIGN(offset, sizeof(s32));
+		*(s32 *)(stream->scan + offset) = ads1015_to_uv(data, chan, res, pga);
+		offset += sizeof(s32);
+	}
+	if (test_bit(ADS1015_MIN, indio_dev->active_scan_mask))
+	{
+		offset = ALIGN(offset, sizeof(s32));
+		*(s32 *)(stream->scan + offset) = ads1015_to_uv(data, chan, min, pga);
+		offset += sizeof(s32);
+	}
+	if (test_bit(ADS1015_MAX, indio_dev->active_scan_mask))
+	{
+		offset = ALIGN(offset, sizeof(s32));
+		*(s32 *)(stream->scan + offset) = ads1015_to_uv(data, chan, max, pga);
+		offset += sizeof(s32);
+	}
+	if (test_bit(ADS1015_RMS, indio_dev->active_scan_mask))
+	{
+		offset = ALIGN(offset, sizeof(u32));
+		*(u32 *)(stream->scan + offset) = ads1015_mag_to_uv(data, chan, rms,
+															pga);
+		offset += sizeof(u32);
+	}
+	if (test_bit(ADS1015_SEQUENCE, indio_dev->active_scan_mask))
+	{
+		offset = ALIGN(offset, sizeof(u32));
+		*(u32 *)(stream->scan + offset) = seq;
+	}
+
+	return iio_push_to_buffers_with_timestamp(indio_dev, stream->scan,
+											  timestamp);
+}
+
+static bool ads1015_capture_hit(struct ads1015_capture *c, int val)
+{
+	bool hit;
+
+	switch (c->mode)
+	{
+	case ADS1015_CAPTURE_RISING:
+		hit = c->prev_valid && c->prev < c->level && val >= c->level;
+		break;
+	case ADS1015_CAPTURE_FALLING:
+		hit = c->prev_valid && c->prev > c->level && val <= c->level;
+		break;
+	case ADS1015_CAPTURE_ABOVE:
+		hit = val >= c->level;
+		break;
+	case ADS1015_CAPTURE_BELOW:
+		hit = val <= c->level;
+		break;
+	default:
+		hit = false;
+		break;
+	}
+
+	c->prev = val;
+	c->prev_valid = true;
+
+	return hit;
+}
+
+/* record a result of the capture channel, data->lock held */
+static void ads1015_capture_sample(struct iio_dev *indio_dev,
+								   struct iio_chan_spec const *chan, int res,
+								   u32 seq, s64 timestamp)
+{
+	struct ads1015_data *data = iio_priv(indio_dev);
+	struct ads1015_capture *c = &data->capture;
+	struct ads1015_capture_sample *rec;
+	unsigned int total = c->pre + c->post;
+	int shift = chan->scan_type.shift;
+	int val = sign_extend32(res >> shift, 15 - shift);
+
+	rec = &c->ring[c->head];
+	rec->timestamp = timestamp;
+	rec->seq = seq;
+	rec->val = val;
+	rec->range = ads1015_fullscale_range[data->conv_pga];
+	c->head = (c->head + 1) % total;
+	if (c->filled < total)
+		c->filled++;
+
+	if (c->state == ADS1015_CAPTURE_ARMED)
+	{
+		/* pre results have to be there before the trigger one */
+		if (!ads1015_capture_hit(c, val) || c->filled <= c->pre)
+			return;
+
+		c->state = ADS1015_CAPTURE_TRIGGERED;
+		c->left = c->post;
+	}
+
+	if (--c->left)
+		return;
+
+	c->state = ADS1015_CAPTURE_DONE;
+	ads1015_notify(data, ADS1015_NOTIFY_CAPTURE_STATE);
+	schedule_work(&data->done_work);
+}
+
+/* store a result of the burst channel, data->lock held */
+static void ads1015_burst_sample(struct ads1015_data *data,
+								 struct iio_chan_spec const *chan, int res,
+								 u32 seq)
+{
+	struct ads1015_burst *b = &data->burst;
+	int shift = chan->scan_type.shift;
+
+	if ((b->fill || b->head) && seq != b->seq + 1)
+		b->missed += seq - b->seq - 1;
+	b->seq = seq;
+
+	b->mem[(b->head % b->ring) * b->length + b->fill] =
+		sign_extend32(res >> shift, 15 - shift);
+	if (++b->fill < b->length)
+		return;
+
+	b->fill = 0;
+	b->head++;
+	ads1015_notify(data, ADS1015_NOTIFY_BURST_READY);
+
+	if (b->blocks && b->head == b->blocks)
+		b->state = ADS1015_BURST_DONE;
+	else if (b->head - b->tail == b->ring)
+		/* the next block to fill has not been read */
+		b->state = ADS1015_BURST_OVERRUN;
+	else
+		return;
+
+	ads1015_notify(data, ADS1015_NOTIFY_BURST_STATE);
+	schedule_work(&data->done_work);
+}
+
+/*
+ * Account one conversion result of data->conv_chan: discard it if it still
+ * carries a previous configuration, otherwise cache it, complete a pending
+ * one-off read and push it if it belongs to the scan. data->lock held.
+ */
+static void ads1015_handle_sample(struct iio_dev *indio_dev, int res, u32 seq,
+								  s64 timestamp)
+{
+	struct ads1015_data *data = iio_priv(indio_dev);
+	bool pushed = false;
+	int ret, chan, raw, k;
+	u64 lat;
+
+	if (data->conv_skip)
+	{
+		data->conv_skip--;
+		return;
+	}
+
+	chan = data->conv_chan;
+
+	/* auto-ranging looks at the input as converted */
+	raw = res;
+	res = ads1015_calibrate(data, &indio_dev->channels[chan], res);
+
+	ads1015_cache_store(data, chan, res, data->conv_pga, timestamp);
+
+	if (chan == data->oneshot_chan)
+	{
+		data->oneshot_chan = -1;
+		complete_all(&data->oneshot_done);
+	}
+
+	if (data->burst.state == ADS1015_BURST_RUNNING &&
+		chan == data->burst.chan)
+		ads1015_burst_sample(data, &indio_dev->channels[chan], res, seq);
+
+	if (!test_bit(chan, &data->scan_chans))
+		return;
+
+	if (data->cfg_changed)
+	{
+		/* first scan with the new settings, don't average across it */
+		data->cfg_changed = false;
+		data->scan_cfg_seq = seq;
+		for (k = 0; k < ADS1015_STREAMS; k++)
+			ads1015_stream_reset(&data->streams[k]);
+		ads1015_stats_reset(&data->stats[chan].acc);
+		data->crossing[chan].state = ADS1015_CROSSING_UNKNOWN;
+		ads1015_notify(data, ADS1015_NOTIFY_SCAN_CONFIG);
+	}
+
+	if (test_bit(chan, &data->autorange))
+		ads1015_autorange(data, chan, raw);
+
+	if (data->stats[chan].window)
+		ads1015_stats_sample(data, &indio_dev->channels[chan], res);
+
+	if (data->crossing[chan].enabled)
+		ads1015_crossing_sample(&data->crossing[chan],
+								&indio_dev->channels[chan], res, timestamp);
+
+	if (data->capture.state == ADS1015_CAPTURE_ARMED ||
+		data->capture.state == ADS1015_CAPTURE_TRIGGERED)
+		ads1015_capture_sample(indio_dev, &indio_dev->channels[chan], res,
+							   seq, timestamp);
+
+	for (k = 0; k < ADS1015_STREAMS; k++)
+	{
+		if (!data->streams[k].enabled)
+			continue;
+
+		ret = ads1015_stream_push(&data->streams[k], chan, res, seq,
+								  timestamp);
+		if (ret)
+			continue;
+
+		/* the sparse timestamps describe the main buffer */
+		if (!k)
+			ads1015_update_ts_ref(data, seq, timestamp);
+		pushed = true;
+	}
+
+	if (!pushed)
+		return;
+
+	lat = iio_get_time_ns(indio_dev) - timestamp;
+	if (!data->lat_count || lat < data->lat_min_ns)
+		data->lat_min_ns = lat;
+	data->lat_max_ns = max(data->lat_max_ns, lat);
+	data->lat_sum_ns += lat;
+	data->lat_count++;
+}
+
+/*
+ * Single-shot conversion of @chan at DR @dr: the channel switch goes out in
+ * the same CFG write that starts it, the result is read on the RDY edge, or
+ * after the conversion time without an IRQ. The conversion settles within
+ * itself, nothing is discarded. conv_lock and data->lock held, the latter
+ * is dropped during the conversion. -ECANCELED if the acquisition stopped
+ * or the chip went into recovery meanwhile.
+ */
+static int ads1015_single_conv(struct ads1015_data *data, int chan, int dr,
+							   int *val)
+{
+	struct iio_dev *indio_dev = iio_priv_to_dev(data);
+	unsigned int old, mask, cfg, conv_time, gen;
+	unsigned long timeout;
+	bool lost = false, polled = false;
+	int ret, pga;
+
+	ret = regmap_read(data->regmap, ADS1015_CFG_REG, &old);
+	if (ret)
+		return ret;
+
+	pga = data->channel_data[chan].pga;
+	mask = ADS1015_CFG_OS_MASK | ADS1015_CFG_MUX_MASK |
+		   ADS1015_CFG_PGA_MASK | ADS1015_CFG_MOD_MASK | ADS1015_CFG_DR_MASK;
+	cfg = 1 << ADS1015_CFG_OS_SHIFT | chan << ADS1015_CFG_MUX_SHIFT |
+		  pga << ADS1015_CFG_PGA_SHIFT |
+		  ADS1015_SINGLESHOT << ADS1015_CFG_MOD_SHIFT |
+		  dr << ADS1015_CFG_DR_SHIFT;
+	cfg = (old & ~mask) | (cfg & mask);
+
+	conv_time = DIV_ROUND_UP(USEC_PER_SEC, data->data_rate[dr]);
+	conv_time += conv_time / 10; /* 10% internal clock inaccuracy */
+
+	reinit_completion(&data->conv_done);
+	WRITE_ONCE(data->edge_period_ns,
+			   DIV_ROUND_UP(NSEC_PER_SEC, data->data_rate[dr]));
+	WRITE_ONCE(data->edge_ns, ktime_get_ns());
+
+	/* always written: OS starts the conversion */
+	ret = regmap_write(data->regmap, ADS1015_CFG_REG, cfg);
+	if (ret)
+		return ret;
+
+	gen = data->acq_gen;
+	mutex_unlock(&data->lock);
+
+	/* the poll timer ticks out of step with the conversion */
+	if (data->irq > 0 &&
+		READ_ONCE(data->storm_state) != ADS1015_STORM_POLLING)
+	{
+		timeout = usecs_to_jiffies(2 * conv_time) + 1;
+		lost = !wait_for_completion_timeout(&data->conv_done, timeout);
+	}
+	else
+	{
+		usleep_range(conv_time, conv_time + 1);
+		polled = true;
 	}
 
-	return ret < 0 ? ret : 0;
-}
+	mutex_lock(&data->lock);
+	if (!data->single_shot || data->acq_gen != gen ||
+		data->state != ADS1015_STATE_OK)
+		return -ECANCELED;
 
-static int ads1015_buffer_preenable(struct iio_dev *indio_dev)
-{
-	// struct ads1015_data *data = iio_priv(indio_dev);
-	// struct device *dev = regmap_get_device(data->regmap);
-	// enable_irq(data->irq);
+	/* lost edge: the conversion is over by now anyway */
+	if (lost)
+		data->watchdog_count++;
+
+	if (lost || polled)
+	{
+		data->timestamp = iio_get_time_ns(indio_dev);
+		data->seq = atomic_inc_return(&data->irq_count);
+	}
+
+	data->conv_chan = chan;
+	data->conv_pga = pga;
+	data->conv_skip = 0;
 
-	return ads1015_set_power_state(iio_priv(indio_dev), true);
+	return ads1015_read_conv(data, val);
 }
 
-static int ads1015_buffer_postdisable(struct iio_dev *indio_dev)
+/*
+ * Take a live scale or sampling frequency change in single-shot modes,
+ * data->lock held: every conversion is configured afresh, nothing to
+ * discard.
+ */
+static void ads1015_single_cfg_apply(struct ads1015_data *data)
 {
-	// struct ads1015_data *data = iio_priv(indio_dev);
-	// struct device *dev = regmap_get_device(data->regmap);
-	// disable_irq(data->irq);
+	int chan = data->scan_chan;
 
-	return ads1015_set_power_state(iio_priv(indio_dev), false);
-}
+	if (!data->cfg_pending)
+		return;
 
-static const struct iio_buffer_setup_ops ads1015_buffer_setup_ops = {
-	/*
-	 * iio_triggered_buffer_postenable:
-	 * Generic function that simply attaches the pollfunc to the trigger.
-	 * Replace this to mess with hardware state before we attach the
-	 * trigger.
-	 */
-	.preenable = ads1015_buffer_preenable,
-	/*
-	 * iio_triggered_buffer_predisable:
-	 * Generic function that simple detaches the pollfunc from the trigger.
-	 * Replace this to put hardware state back again after the trigger is
-	 * detached but before userspace knows we have disabled the ring.
-	 */
-	.postdisable = ads1015_buffer_postdisable,
-	.validate_scan_mask = &iio_validate_scan_mask_onehot,
-};
+	data->cfg_pending = false;
+	data->cfg_changed = true;
+	data->scan_pga = data->channel_data[chan].pga;
+	data->scan_dr = data->channel_data[chan].data_rate;
+}
 
-static int ads1015_get_adc_result(struct ads1015_data *data, int chan, int *val)
+/*
+ * Triggered capture: convert the scan channels at the trigger, then serve a
+ * pending direct read of another input before returning.
+ */
+static irqreturn_t ads1015_trigger_handler(int irq, void *p)
 {
-	int ret, pga, dr, dr_old, conv_time;
-	unsigned int old, mask, cfg;
+	struct iio_poll_func *pf = p;
+	struct iio_dev *indio_dev = pf->indio_dev;
+	struct ads1015_data *data = iio_priv(indio_dev);
+	int ret, res, chan;
 
-	if (chan < 0 || chan >= ADS1015_CHANNELS)
-		return -EINVAL;
+	mutex_lock(&data->conv_lock);
+	mutex_lock(&data->lock);
 
-	ret = regmap_read(data->regmap, ADS1015_CFG_REG, &old);
-	if (ret)
-		return ret;
+	if (data->state != ADS1015_STATE_OK || ads1015_paused(data))
+		goto out;
 
-	pga = data->channel_data[chan].pga;
-	dr = data->channel_data[chan].data_rate;
-	mask = ADS1015_CFG_MUX_MASK | ADS1015_CFG_PGA_MASK |
-		   ADS1015_CFG_DR_MASK;
-	cfg = chan << ADS1015_CFG_MUX_SHIFT | pga << ADS1015_CFG_PGA_SHIFT |
-		  dr << ADS1015_CFG_DR_SHIFT;
+	ads1015_single_cfg_apply(data);
 
-	cfg = (old & ~mask) | (cfg & mask);
-	if (old != cfg)
+	for_each_set_bit(chan, &data->scan_chans, ADS1015_CHANNELS)
 	{
-		ret = regmap_write(data->regmap, ADS1015_CFG_REG, cfg);
-		if (ret)
-			return ret;
-		data->conv_invalid = true;
+		ret = ads1015_single_conv(data, chan,
+								  data->channel_data[chan].data_rate, &res);
+		if (ret < 0)
+			goto err;
+
+		/* stamped at its own RDY edge, not at the trigger */
+		ads1015_handle_sample(indio_dev, res, data->seq, data->timestamp);
 	}
-	if (data->conv_invalid)
+
+	chan = data->oneshot_chan;
+	if (chan >= 0)
 	{
-		dr_old = (old & ADS1015_CFG_DR_MASK) >> ADS1015_CFG_DR_SHIFT;
-		conv_time = DIV_ROUND_UP(USEC_PER_SEC, data->data_rate[dr_old]);
-		conv_time += DIV_ROUND_UP(USEC_PER_SEC, data->data_rate[dr]);
-		conv_time += conv_time / 10; /* 10% internal clock inaccuracy */
-		usleep_range(conv_time, conv_time + 1);
-		data->conv_invalid = false;
+		ret = ads1015_single_conv(data, chan,
+								  data->channel_data[chan].data_rate, &res);
+		if (ret < 0)
+			goto err;
+
+		ads1015_handle_sample(indio_dev, res, data->seq, data->timestamp);
 	}
+	goto out;
+
+err:
+	if (ret != -ECANCELED)
+		ads1015_report_error(data, ret);
+out:
+	mutex_unlock(&data->lock);
+	mutex_unlock(&data->conv_lock);
+	iio_trigger_notify_done(indio_dev->trig);
 
-	return regmap_read(data->regmap, ADS1015_CONV_REG, val);
+	return IRQ_HANDLED;
 }
 
-static int ads1015_set_scale(struct ads1015_data *data,
-							 struct iio_chan_spec const *chan,
-							 int scale, int uscale)
+/* input due for a slot with the earliest deadline, -1 and @next if none */
+static int ads1015_sched_pick(struct ads1015_data *data, s64 now, s64 *next)
 {
-	int i;
-	int fullscale = div_s64((scale * 1000000LL + uscale) << (chan->scan_type.realbits - 1), 1000000);
+	struct ads1015_sched_chan *slot;
+	s64 deadline, best_deadline = 0;
+	int chan, best = -1;
 
-	for (i = 0; i < ARRAY_SIZE(ads1015_fullscale_range); i++)
+	*next = S64_MAX;
+	for_each_set_bit(chan, &data->scan_chans, ADS1015_CHANNELS)
 	{
-		if (ads1015_fullscale_range[i] == fullscale)
+		slot = &data->sched[chan];
+		if (slot->release > now)
 		{
-			data->channel_data[chan->address].pga = i;
-			return 0;
+			*next = min(*next, slot->release);
+			continue;
+		}
+
+		deadline = slot->release + slot->period;
+		if (best < 0 || deadline < best_deadline)
+		{
+			best = chan;
+			best_deadline = deadline;
 		}
 	}
 
-	return -EINVAL;
+	return best;
 }
 
-static int ads1015_set_data_rate(struct ads1015_data *data, int chan, int rate)
+/*
+ * One scheduler slot: convert the input due with the earliest deadline, or
+ * sleep on sched_timer until the next release. A direct read of another
+ * input goes in between two slots.
+ */
+static void ads1015_sched_work(struct work_struct *work)
 {
-	int i;
+	struct ads1015_data *data = container_of(work, struct ads1015_data,
+											 sched_work);
+	struct iio_dev *indio_dev = iio_priv_to_dev(data);
+	struct ads1015_sched_chan *slot;
+	int ret, res, chan;
+	s64 now, next;
 
-	for (i = 0; i < ARRAY_SIZE(ads1015_data_rate); i++)
+	mutex_lock(&data->conv_lock);
+	mutex_lock(&data->lock);
+
+	/* recover_work queues the scheduler again once the chip is back */
+	if (!data->sched_on || data->state != ADS1015_STATE_OK)
+		goto out;
+
+	now = ktime_get_ns();
+	chan = ads1015_sched_pick(data, now, &next);
+	if (chan < 0)
 	{
-		if (data->data_rate[i] == rate)
+		hrtimer_start(&data->sched_timer, ns_to_ktime(next), HRTIMER_MODE_ABS);
+		goto out;
+	}
+
+	slot = &data->sched[chan];
+	slot->release += slot->period;
+	if (slot->release <= now)
+	{
+		/* a whole period behind, don't try to catch up */
+		data->sched_overruns++;
+		slot->release = now + slot->period;
+	}
+
+	/* every buffer is full and waiting for its reader: skip the slot */
+	if (!ads1015_paused(data))
+	{
+		ads1015_single_cfg_apply(data);
+
+		ret = ads1015_single_conv(data, chan, slot->dr, &res);
+		if (ret < 0)
+			goto err;
+
+		ads1015_handle_sample(indio_dev, res, data->seq, data->timestamp);
+
+		chan = data->oneshot_chan;
+		if (chan >= 0)
 		{
-			data->channel_data[chan].data_rate = i;
-			return 0;
+			ret = ads1015_single_conv(data, chan,
+									  data->channel_data[chan].data_rate,
+									  &res);
+			if (ret < 0)
+				goto err;
+
+			ads1015_handle_sample(indio_dev, res, data->seq,
+								  data->timestamp);
 		}
 	}
 
-	return -EINVAL;
+	/* the next slot may be due already, let others have data->lock first */
+	queue_work(system_highpri_wq, &data->sched_work);
+	goto out;
+
+err:
+	if (ret != -ECANCELED)
+		ads1015_report_error(data, ret);
+out:
+	mutex_unlock(&data->lock);
+	mutex_unlock(&data->conv_lock);
 }
 
-static int ads1015_read_raw(struct iio_dev *indio_dev,
-							struct iio_chan_spec const *chan, int *val,
-							int *val2, long mask)
+static enum hrtimer_restart ads1015_sched_timer_fn(struct hrtimer *timer)
 {
-	int ret, idx;
+	struct ads1015_data *data = container_of(timer, struct ads1015_data,
+											 sched_timer);
+
+	queue_work(system_highpri_wq, &data->sched_work);
+
+	return HRTIMER_NORESTART;
+}
+
+static irqreturn_t __attribute__((optimize("O0"))) ads1015_irq_handler_thread(int irq, void *private)
+{
+	struct iio_dev *indio_dev = private;
 	struct ads1015_data *data = iio_priv(indio_dev);
+	struct ads1015_raw_sample sample;
+	int ret, res, chan, scan_chan;
+	bool read, resync = false;
 
-	mutex_lock(&data->lock);
-	switch (mask)
+	if (test_and_clear_bit(ADS1015_FLAG_SCHED, &data->flags))
+		ads1015_apply_irq_priority(data);
+
+	/* the results the hard IRQ handler read meanwhile are in the ring */
+	read = READ_ONCE(data->edge_read);
+
+	/* return if no buffer is enabled or a trigger paces it */
+	if (!READ_ONCE(data->active_streams) || READ_ONCE(data->single_shot))
 	{
-	case IIO_CHAN_INFO_RAW:
+		data->use_buffer = false;
+		data->ring_tail = READ_ONCE(data->ring_head);
+		goto err;
+	}
+
+	mutex_lock(&data->lock);
+
+	/* recover_work owns the chip until it is back in sync */
+	if (data->state != ADS1015_STATE_OK)
+		goto err_unlock;
+
+	scan_chan = data->scan_chan;
+
+	if (test_and_clear_bit(ADS1015_FLAG_WATCHDOG, &data->flags))
 	{
-		int shift;
+		/* woken by the watchdog: an edge got lost, poll CONV instead */
+		data->watchdog_count++;
+		data->timestamp = iio_get_time_ns(indio_dev);
+		/* the conversion behind the missed edge still gets a number */
+		data->seq = atomic_inc_return(&data->irq_count);
+		resync = true;
+	}
 
-		// cannot read directly if buffered capture enabled.
-		if (iio_buffer_enabled(indio_dev))
+	if (!data->use_buffer)
+	{
+		/* first edge of the capture: program the scan channel */
+		ret = ads1015_buffer_set_chan(data, scan_chan);
+		if (ret < 0)
 		{
-			ret = -EAGAIN;
-			break;
+			ads1015_report_error(data, ret);
+			goto err_unlock;
 		}
+		data->use_buffer = true;
 
-		shift = chan->scan_type.shift;
+		/* the result just completed was taken with the old config too */
+		if (data->conv_skip)
+			goto err_unlock;
+	}
 
-		ret = iio_device_claim_direct_mode(indio_dev);
-		if (ret)
-			break;
+	while (ads1015_ring_get(data, &sample))
+		ads1015_handle_sample(indio_dev, sample.val, sample.seq,
+							  sample.timestamp);
 
-		ret = ads1015_set_power_state(data, true);
-		if (ret < 0)
-			goto release_direct;
+	if (data->atomic_err)
+	{
+		ret = data->atomic_err;
+		data->atomic_err = 0;
+		ads1015_report_error(data, ret);
+		goto err_unlock;
+	}
 
-		ret = ads1015_get_adc_result(data, chan->address, val);
-		if (ret < 0)
+	if (!read || resync)
+	{
+		/* fast conversion, or already read along with the group */
+		if (data->batch_valid && !resync)
 		{
-			ads1015_set_power_state(data, false);
-			goto release_direct;
+			res = data->batch_res;
+		}
+		else
+		{
+			ret = ads1015_read_conv(data, &res);
+			if (ret < 0)
+			{
+				ads1015_report_error(data, ret);
+				goto err_unlock;
+			}
 		}
 
-		*val = sign_extend32(*val >> shift, 15 - shift);
+		ads1015_handle_sample(indio_dev, res, data->seq, data->timestamp);
+	}
 
-		ret = ads1015_set_power_state(data, false);
+	/* schedule the next conversion: a pending one-off read or the scan */
+	chan = data->oneshot_chan >= 0 ? data->oneshot_chan : scan_chan;
+	if (!data->conv_skip &&
+		(chan != data->conv_chan || (chan == scan_chan && data->cfg_pending)))
+	{
+		ret = ads1015_buffer_set_chan(data, chan);
 		if (ret < 0)
-			goto release_direct;
+		{
+			ads1015_report_error(data, ret);
+			goto err_unlock;
+		}
 
-		ret = IIO_VAL_INT;
-	release_direct:
-		iio_device_release_direct_mode(indio_dev);
-		break;
+		if (chan == scan_chan && data->cfg_pending)
+		{
+			/* the conversion in flight still has the old settings */
+			data->cfg_pending = false;
+			data->cfg_changed = true;
+			data->scan_pga = data->channel_data[chan].pga;
+			data->scan_dr = data->channel_data[chan].data_rate;
+		}
 	}
-	case IIO_CHAN_INFO_SCALE:
-		idx = data->channel_data[chan->address].pga;
-		*val = ads1015_fullscale_range[idx];
-		*val2 = chan->scan_type.realbits - 1;
-		ret = IIO_VAL_FRACTIONAL_LOG2;
-		break;
-	case IIO_CHAN_INFO_SAMP_FREQ:
-		idx = data->channel_data[chan->address].data_rate;
-		*val = data->data_rate[idx];
-		ret = IIO_VAL_INT;
-		break;
-	default:
-		ret = -EINVAL;
-		break;
+
+	if (resync)
+	{
+		/* rewrite CFG and the RDY thresholds, restarting the conversion */
+		regcache_mark_dirty(data->regmap);
+		ret = regcache_sync(data->regmap);
+		if (ret < 0)
+		{
+			ads1015_report_error(data, ret);
+			goto err_unlock;
+		}
+		data->conv_skip = 1;
 	}
+
+err_unlock:
 	mutex_unlock(&data->lock);
+err:
 
-	return ret;
+	return IRQ_HANDLED;
 }
 
-static int ads1015_write_raw(struct iio_dev *indio_dev,
-							 struct iio_chan_spec const *chan, int val,
-							 int val2, long mask)
+static int ads1015_trigger_set_state(struct iio_trigger *trig, bool state)
 {
-	struct ads1015_data *data = iio_priv(indio_dev);
+	struct ads1015_data *data = iio_trigger_get_drvdata(trig);
 	int ret;
 
-	mutex_lock(&data->lock);
-	switch (mask)
+	/* keep the ADC converting, and the edges coming, while in use */
+	if (state)
 	{
-	case IIO_CHAN_INFO_SCALE:
-		ret = ads1015_set_scale(data, chan, val, val2);
-		break;
-	case IIO_CHAN_INFO_SAMP_FREQ:
-		ret = ads1015_set_data_rate(data, chan->address, val);
-		break;
-	default:
-		ret = -EINVAL;
-		break;
+		ret = ads1015_set_power_state(data, true);
+		if (ret < 0)
+			return ret;
 	}
-	mutex_unlock(&data->lock);
 
-	return ret;
+	WRITE_ONCE(data->edge_ns, ktime_get_ns());
+	WRITE_ONCE(data->trig_enabled, state);
+
+	if (!state)
+		return ads1015_set_power_state(data, false);
+
+	return 0;
 }
 
-static IIO_CONST_ATTR_NAMED(ads1015_scale_available, scale_available,
-							"3 2 1 0.5 0.25 0.125");
-static IIO_CONST_ATTR_NAMED(ads1115_scale_available, scale_available,
-							"0.1875 0.125 0.0625 0.03125 0.015625 0.007813");
+/* the ADC itself is paced by the RDY interrupt without a trigger */
+static int ads1015_trigger_validate_device(struct iio_trigger *trig,
+										   struct iio_dev *indio_dev)
+{
+	struct ads1015_data *data = iio_trigger_get_drvdata(trig);
+	int k;
 
-static IIO_CONST_ATTR_NAMED(ads1015_sampling_frequency_available,
-							sampling_frequency_available, "128 250 490 920 1600 2400 3300");
-static IIO_CONST_ATTR_NAMED(ads1115_sampling_frequency_available,
-							sampling_frequency_available, "8 16 32 64 128 250 475 860");
+	for (k = 0; k < ADS1015_STREAMS; k++)
+		if (indio_dev == data->streams[k].indio_dev)
+			return -EINVAL;
 
-static struct attribute *ads1015_attributes[] = {
-	&iio_const_attr_ads1015_scale_available.dev_attr.attr,
-	&iio_const_attr_ads1015_sampling_frequency_available.dev_attr.attr,
-	NULL,
-};
+	return 0;
+}
 
-static const struct attribute_group ads1015_attribute_group = {
-	.attrs = ads1015_attributes,
+static const struct iio_trigger_ops ads1015_trigger_ops = {
+	.set_trigger_state = ads1015_trigger_set_state,
+	.validate_device = ads1015_trigger_validate_device,
 };
 
-static struct attribute *ads1115_attributes[] = {
-	&iio_const_attr_ads1115_scale_available.dev_attr.attr,
-	&iio_const_attr_ads1115_sampling_frequency_available.dev_attr.attr,
-	NULL,
-};
+static int ads1015_probe_trigger(struct iio_dev *indio_dev)
+{
+	struct ads1015_data *data = iio_priv(indio_dev);
+	struct device *dev = indio_dev->dev.parent;
 
-static const struct attribute_group ads1115_attribute_group = {
-	.attrs = ads1115_attributes,
-};
+	data->trig = devm_iio_trigger_alloc(dev, "%s-dev%d", indio_dev->name,
+										indio_dev->id);
+	if (!data->trig)
+		return -ENOMEM;
 
-static const struct iio_info ads1015_info = {
-	.read_raw = ads1015_read_raw,
-	.write_raw = ads1015_write_raw,
-	.attrs = &ads1015_attribute_group,
+	data->trig->dev.parent = dev;
+	data->trig->ops = &ads1015_trigger_ops;
+	iio_trigger_set_drvdata(data->trig, data);
+
+	return devm_iio_trigger_register(dev, data->trig);
+}
+
+static void ads1015_clear_irq_affinity(void *data)
+{
+	struct ads1015_data *adata = data;
+
+	irq_set_affinity_hint(adata->irq, NULL);
+}
+
+/*
+ * ADCs sharing one ALERT/RDY line, one per IRQ number. members is walked
+ * by the hard handler under members_lock, and by the thread under lock,
+ * which also keeps a member from leaving while its thread runs.
+ */
+struct ads1015_irq_group
+{
+	struct list_head node;
+	int irq;
+	struct list_head members;
+	raw_spinlock_t members_lock;
+	struct mutex lock;
 };
 
-static const struct iio_info ads1115_info = {
-	.read_raw = ads1015_read_raw,
-	.write_raw = ads1015_write_raw,
-	.attrs = &ads1115_attribute_group,
-};
+static LIST_HEAD(ads1015_irq_groups);
+static DEFINE_MUTEX(ads1015_irq_groups_lock);
 
-#ifdef CONFIG_OF
-static int ads1015_get_channels_config_of(struct i2c_client *client)
+/* how far into its conversion period @data is, in 1/16, -1 if idle */
+static int ads1015_edge_due(struct ads1015_data *data, s64 now)
 {
-	struct iio_dev *indio_dev = i2c_get_clientdata(client);
-	struct ads1015_data *data = iio_priv(indio_dev);
-	struct device_node *node;
+	s64 period = READ_ONCE(data->edge_period_ns);
 
-	if (!client->dev.of_node ||
-		!of_get_next_child(client->dev.of_node, NULL))
-		return -EINVAL;
+	if (data->state != ADS1015_STATE_OK || !period)
+		return -1;
 
-	for_each_child_of_node(client->dev.of_node, node)
+	if (READ_ONCE(data->single_shot))
 	{
-		u32 pval;
-		unsigned int channel;
-		unsigned int pga = ADS1015_DEFAULT_PGA;
-		unsigned int data_rate = ADS1015_DEFAULT_DATA_RATE;
+		/* a single-shot conversion in flight, or nothing to end */
+		if (completion_done(&data->conv_done))
+			return -1;
+	}
+	else if (!READ_ONCE(data->active_streams) &&
+			 !READ_ONCE(data->trig_enabled))
+	{
+		return -1;
+	}
 
-		if (of_property_read_u32(node, "reg", &pval))
+	return div64_s64((now - READ_ONCE(data->edge_ns)) * 16, period);
+}
+
+static irqreturn_t ads1015_group_handler(int irq, void *private)
+{
+	struct ads1015_irq_group *group = private;
+	struct ads1015_data *data, *best = NULL;
+	irqreturn_t ret = IRQ_NONE;
+	s64 now = ktime_get_ns();
+	int due, best_due = ADS1015_EDGE_DUE - 1;
+
+	raw_spin_lock(&group->members_lock);
+
+	list_for_each_entry(data, &group->members, group_node)
+	{
+		due = ads1015_edge_due(data, now);
+		if (due > best_due)
 		{
-			dev_err(&client->dev, "invalid reg on %pOF\n",
-					node);
-			continue;
+			best = data;
+			best_due = due;
 		}
+	}
 
-		channel = pval;
-		if (channel >= ADS1015_CHANNELS)
-		{
-			dev_err(&client->dev,
-					"invalid channel index %d on %pOF\n",
-					channel, node);
+	list_for_each_entry(data, &group->members, group_node)
+	{
+		if (data != best && ads1015_edge_due(data, now) < ADS1015_EDGE_LATE)
 			continue;
-		}
 
-		if (!of_property_read_u32(node, "ti,gain", &pval))
+		WRITE_ONCE(data->edge_ns, now);
+		if (ads1015_irq_handler(irq, iio_priv_to_dev(data)) == IRQ_WAKE_THREAD)
 		{
-			pga = pval;
-			if (pga > 6)
-			{
-				dev_err(&client->dev, "invalid gain on %pOF\n",
-						node);
-				of_node_put(node);
-				return -EINVAL;
-			}
+			set_bit(ADS1015_FLAG_WAKE, &data->flags);
+			ret = IRQ_WAKE_THREAD;
 		}
-
-		if (!of_property_read_u32(node, "ti,datarate", &pval))
+		else if (ret == IRQ_NONE)
 		{
-			data_rate = pval;
-			if (data_rate > 7)
-			{
-				dev_err(&client->dev,
-						"invalid data_rate on %pOF\n",
-						node);
-				of_node_put(node);
-				return -EINVAL;
-			}
+			ret = IRQ_HANDLED;
 		}
-
-		data->channel_data[channel].pga = pga;
-		data->channel_data[channel].data_rate = data_rate;
-		dev_dbg(&client->dev, "channel=%d pga=%d data_rate=%d", channel, pga, data_rate);
 	}
 
-	return 0;
+	raw_spin_unlock(&group->members_lock);
+
+	return ret;
 }
-#endif
 
-static void ads1015_get_channels_config(struct i2c_client *client)
+/* results of up to ADS1015_GROUP_BATCH woken members on one adapter */
+static void ads1015_group_batch_read(struct ads1015_irq_group *group)
 {
-	unsigned int k;
-
-	struct iio_dev *indio_dev = i2c_get_clientdata(client);
-	struct ads1015_data *data = iio_priv(indio_dev);
-	struct ads1015_platform_data *pdata = dev_get_platdata(&client->dev);
+	struct ads1015_data *batch[ADS1015_GROUP_BATCH];
+	struct i2c_msg msgs[2 * ADS1015_GROUP_BATCH];
+	u8 rx[ADS1015_GROUP_BATCH][2];
+	u8 reg = ADS1015_CONV_REG;
+	struct i2c_adapter *adap = NULL;
+	struct i2c_client *client;
+	struct ads1015_data *data;
+	int n = 0, k;
 
-	/* prefer platform data */
-	if (pdata)
+	list_for_each_entry(data, &group->members, group_node)
 	{
-		memcpy(data->channel_data, pdata->channel_data,
-			   sizeof(data->channel_data));
-		return;
+		/* the atomic mode has the results in its ring already */
+		if (!test_bit(ADS1015_FLAG_WAKE, &data->flags) ||
+			READ_ONCE(data->edge_read) || n == ADS1015_GROUP_BATCH)
+			continue;
+
+		client = to_i2c_client(regmap_get_device(data->regmap));
+		if (adap && client->adapter != adap)
+			continue;
+
+		adap = client->adapter;
+		msgs[2 * n].addr = client->addr;
+		msgs[2 * n].flags = 0;
+		msgs[2 * n].len = 1;
+		msgs[2 * n].buf = &reg;
+		msgs[2 * n + 1].addr = client->addr;
+		msgs[2 * n + 1].flags = I2C_M_RD;
+		msgs[2 * n + 1].len = 2;
+		msgs[2 * n + 1].buf = rx[n];
+		batch[n++] = data;
 	}
 
-#ifdef CONFIG_OF
-	if (!ads1015_get_channels_config_of(client))
+	/* a lone member reads on its own, as do all after a failed batch */
+	if (n < 2 || i2c_transfer(adap, msgs, 2 * n) != 2 * n)
 		return;
-#endif
-	/* fallback on default configuration */
-	for (k = 0; k < ADS1015_CHANNELS; ++k)
+
+	for (k = 0; k < n; k++)
 	{
-		data->channel_data[k].pga = ADS1015_DEFAULT_PGA;
-		data->channel_data[k].data_rate = ADS1015_DEFAULT_DATA_RATE;
+		batch[k]->batch_res = rx[k][0] << 8 | rx[k][1];
+		batch[k]->batch_valid = true;
 	}
 }
 
-static int ads1015_set_conv_mode(struct ads1015_data *data, int mode)
+static irqreturn_t ads1015_group_thread(int irq, void *private)
 {
-	return regmap_update_bits(data->regmap, ADS1015_CFG_REG,
-							  ADS1015_CFG_MOD_MASK,
-							  mode << ADS1015_CFG_MOD_SHIFT);
-}
+	struct ads1015_irq_group *group = private;
+	struct ads1015_data *data;
 
-static int ads1015_set_conv_ready_pin(struct ads1015_data *data)
-{
-	int ret;
+	mutex_lock(&group->lock);
 
-	ret = regmap_write(data->regmap, ADS1015_LO_THRESH_REG, 0);
-	if (ret)
-		return ret;
+	ads1015_group_batch_read(group);
 
-	ret = regmap_write(data->regmap, ADS1015_HI_THRESH_REG, 0xFFFF);
-	if (ret)
-		return ret;
+	list_for_each_entry(data, &group->members, group_node)
+	{
+		if (!test_and_clear_bit(ADS1015_FLAG_WAKE, &data->flags))
+			continue;
 
-	return regmap_update_bits(data->regmap, ADS1015_CFG_REG, ADS1015_CFG_COMP_QUE_MASK, 0);
-}
+		ads1015_irq_handler_thread(irq, iio_priv_to_dev(data));
+		data->batch_valid = false;
+	}
 
-static irqreturn_t __attribute__((optimize("O0"))) ads1015_irq_handler(int irq, void *private)
-{
-	struct iio_dev *indio_dev = private;
-	struct ads1015_data *data = iio_priv(indio_dev);
+	mutex_unlock(&group->lock);
 
-	data->timestamp = iio_get_time_ns(indio_dev);
-	return IRQ_WAKE_THREAD;
+	return IRQ_HANDLED;
 }
 
-static irqreturn_t __attribute__((optimize("O0"))) ads1015_irq_handler_thread(int irq, void *private)
+static void ads1015_group_leave(void *arg)
 {
-	struct iio_dev *indio_dev = private;
-	struct ads1015_data *data = iio_priv(indio_dev);
+	struct ads1015_data *data = arg;
+	struct ads1015_irq_group *group = data->group;
+	unsigned long flags;
 
-	struct device *dev = regmap_get_device(data->regmap);
-	s16 buf[8]; /* 1x s16 ADC val + 3x s16 padding +  4x s16 timestamp */
-	int ret, res, chan;
+	mutex_lock(&ads1015_irq_groups_lock);
 
-#ifdef ADS1015_SHOW_DELTA
-	s64 timestamp;
-	u32 tdelta;
-#endif
+	mutex_lock(&group->lock);
+	raw_spin_lock_irqsave(&group->members_lock, flags);
+	list_del(&data->group_node);
+	raw_spin_unlock_irqrestore(&group->members_lock, flags);
+	mutex_unlock(&group->lock);
 
-	/* return if buffer not anabled */
-	if (!iio_buffer_enabled(indio_dev))
+	if (list_empty(&group->members))
 	{
-		dev_dbg_ratelimited(dev, "buffer not enabled");
-		data->use_buffer = false;
-		goto err;
+		free_irq(group->irq, group);
+		list_del(&group->node);
+		mutex_destroy(&group->lock);
+		kfree(group);
 	}
 
-	memset(buf, 0, sizeof(buf));
-
-	mutex_lock(&data->lock);
+	mutex_unlock(&ads1015_irq_groups_lock);
+}
 
-	if (data->use_buffer)
-	{
-		/* fast conversion*/
-		ret = regmap_read(data->regmap, ADS1015_CONV_REG, &res);
-		if (ret < 0)
-		{
-			dev_dbg_ratelimited(dev, "regmap_read ret=%d", ret);
-			mutex_unlock(&data->lock);
-			goto err;
-		}
-	}
-	else
-	{
-		/* conversion with config update */
-		chan = find_first_bit(indio_dev->active_scan_mask,
-							  indio_dev->masklength);
-		dev_dbg(dev, "config conversion chan=%d", chan);
-		ret = ads1015_get_adc_result(data, chan, &res);
-		if (ret < 0)
-		{
-			dev_dbg_ratelimited(dev, "ads1015_get_adc_result ret=%d", ret);
-			mutex_unlock(&data->lock);
-			goto err;
-		}
-	}
+/* join the group of data->irq, requesting the IRQ for the first member */
+static int ads1015_group_join(struct iio_dev *indio_dev,
+							  unsigned long irq_type)
+{
+	struct ads1015_data *data = iio_priv(indio_dev);
+	struct device *dev = regmap_get_device(data->regmap);
+	struct ads1015_irq_group *group;
+	unsigned long flags;
+	int ret = 0;
 
-	buf[0] = res;
+	mutex_lock(&ads1015_irq_groups_lock);
 
-	mutex_unlock(&data->lock);
+	list_for_each_entry(group, &ads1015_irq_groups, node)
+		if (group->irq == data->irq)
+			goto join;
 
-#ifdef ADS1015_SHOW_DELTA
-	timestamp = iio_get_time_ns(indio_dev);
-#endif
+	group = kzalloc(sizeof(*group), GFP_KERNEL);
+	if (!group)
+	{
+		ret = -ENOMEM;
+		goto out;
+	}
 
-	ret = iio_push_to_buffers_with_timestamp(indio_dev, buf, data->timestamp);
+	group->irq = data->irq;
+	INIT_LIST_HEAD(&group->members);
+	raw_spin_lock_init(&group->members_lock);
+	mutex_init(&group->lock);
 
-#ifdef ADS1015_SHOW_DELTA
-	tdelta = (u32)(timestamp - data->timestamp) / 1000;
-	dev_dbg_ratelimited(dev, "iio_push_to_buffers ret=%d delta=%d", ret, tdelta);
-#endif
+	/* IRQF_SHARED lets other drivers on the line too */
+	ret = request_threaded_irq(data->irq, &ads1015_group_handler,
+							   &ads1015_group_thread,
+							   irq_type | IRQF_ONESHOT | IRQF_SHARED,
+							   ADS1015_DRV_NAME, group);
+	if (ret)
+	{
+		mutex_destroy(&group->lock);
+		kfree(group);
+		goto out;
+	}
+	list_add(&group->node, &ads1015_irq_groups);
+
+join:
+	mutex_lock(&group->lock);
+	raw_spin_lock_irqsave(&group->members_lock, flags);
+	list_add_tail(&data->group_node, &group->members);
+	data->group = group;
+	raw_spin_unlock_irqrestore(&group->members_lock, flags);
+	mutex_unlock(&group->lock);
+out:
+	mutex_unlock(&ads1015_irq_groups_lock);
 
-	data->use_buffer = true;
+	if (ret)
+		return ret;
 
-err:
+	dev_dbg(dev, "sharing irq %d", data->irq);
 
-	return IRQ_HANDLED;
+	return devm_add_action_or_reset(dev, ads1015_group_leave, data);
 }
 
 static int __attribute__((optimize("O0"))) ads1015_probe_irq(struct iio_dev *indio_dev)
@@ -758,27 +5611,130 @@ static int __attribute__((optimize("O0"))) ads1015_probe_irq(struct iio_dev *ind
 		return -EINVAL;
 	}
 
-	ret = devm_request_threaded_irq(dev, data->irq, &ads1015_irq_handler,
-									&ads1015_irq_handler_thread,
-									irq_type | IRQF_ONESHOT,
-									indio_dev->name,
-									indio_dev);
+	if (data->shared_irq)
+		ret = ads1015_group_join(indio_dev, irq_type);
+	else
+		ret = devm_request_threaded_irq(dev, data->irq, &ads1015_irq_handler,
+										&ads1015_irq_handler_thread,
+										irq_type | IRQF_ONESHOT,
+										indio_dev->name,
+										indio_dev);
 	if (ret)
 	{
 		dev_err(dev, "failed to request trigger irq %d\n", data->irq);
+		return ret;
 	}
 
-	return ret;
+	/* the hint has to be gone before devres frees the IRQ */
+	ret = devm_add_action_or_reset(dev, ads1015_clear_irq_affinity, data);
+	if (ret)
+		return ret;
+
+	if (!cpumask_empty(&data->irq_cpus))
+	{
+		ret = irq_set_affinity_hint(data->irq, &data->irq_cpus);
+		if (ret)
+			dev_warn(dev, "failed to set irq affinity: %d\n", ret);
+	}
+
+	if (data->irq_priority != ADS1015_IRQ_THREAD_PRIO)
+	{
+		set_bit(ADS1015_FLAG_SCHED, &data->flags);
+		ads1015_wake_thread(data);
+	}
+
+	return 0;
+}
+
+static void ads1015_free_pollfunc(void *pf)
+{
+	iio_dealloc_pollfunc(pf);
+}
+
+/*
+ * Allocate the companion devices: same scan elements as the main device,
+ * their own buffer, scan mask and decimation.
+ */
+static int ads1015_probe_streams(struct iio_dev *indio_dev)
+{
+	struct ads1015_data *data = iio_priv(indio_dev);
+	struct device *dev = indio_dev->dev.parent;
+	struct iio_chan_spec *channels;
+	struct ads1015_stream *stream;
+	struct iio_buffer *buffer;
+	struct iio_dev *sdev;
+	int k, i;
+
+	data->streams[0].data = data;
+	data->streams[0].indio_dev = indio_dev;
+	data->streams[0].decimation = 1;
+
+	channels = devm_kmemdup(dev, indio_dev->channels,
+							indio_dev->num_channels * sizeof(*channels),
+							GFP_KERNEL);
+	if (!channels)
+		return -ENOMEM;
+
+	for (i = 0; i < indio_dev->num_channels; i++)
+	{
+		channels[i].info_mask_separate = 0;
+		channels[i].info_mask_shared_by_type = 0;
+		channels[i].ext_info = NULL;
+	}
+
+	for (k = 1; k < ADS1015_STREAMS; k++)
+	{
+		stream = &data->streams[k];
+
+		sdev = devm_iio_device_alloc(dev, sizeof(stream));
+		if (!sdev)
+			return -ENOMEM;
+
+		*(struct ads1015_stream **)iio_priv(sdev) = stream;
+		stream->data = data;
+		stream->indio_dev = sdev;
+		stream->decimation = 1;
+
+		sdev->dev.parent = dev;
+		sdev->name = devm_kasprintf(dev, GFP_KERNEL, "%s-stream%d",
+									indio_dev->name, k);
+		if (!sdev->name)
+			return -ENOMEM;
+
+		sdev->modes = INDIO_BUFFER_SOFTWARE;
+		sdev->setup_ops = &ads1015_buffer_setup_ops;
+		sdev->channels = channels;
+		sdev->num_channels = indio_dev->num_channels;
+		sdev->info = &ads1015_stream_info;
+
+		buffer = ads1015_buffer_alloc(sdev, data);
+		if (!buffer)
+		{
+			dev_err(dev, "iio buffer setup failed\n");
+			return -ENOMEM;
+		}
+
+		iio_device_attach_buffer(sdev, buffer);
+	}
+
+	return 0;
+}
+
+static void ads1015_unregister_streams(struct ads1015_data *data, int count)
+{
+	while (--count > 0)
+		iio_device_unregister(data->streams[count].indio_dev);
 }
 
 static int __attribute__((optimize("O0"))) ads1015_probe(struct i2c_client *client,
 														 const struct i2c_device_id *id)
 {
+	struct regmap_config regmap_config;
 	struct iio_dev *indio_dev;
 	struct iio_buffer *buffer;
 	struct ads1015_data *data;
 	enum chip_ids chip;
-	int ret;
+	int ret, k;
 
 	// allocate private data
 	indio_dev = devm_iio_device_alloc(&client->dev, sizeof(*data));
@@ -789,11 +5745,29 @@ static int __attribute__((optimize("O0"))) ads1015_probe(struct i2c_client *clie
 	i2c_set_clientdata(client, indio_dev);
 
 	mutex_init(&data->lock);
+	mutex_init(&data->conv_lock);
+	init_completion(&data->oneshot_done);
+	init_completion(&data->conv_done);
+	INIT_DELAYED_WORK(&data->recover_work, ads1015_recover_work);
+	raw_spin_lock_init(&data->atomic_lock);
+	mutex_init(&data->regmap_lock);
+	hrtimer_init(&data->watchdog, CLOCK_MONOTONIC, HRTIMER_MODE_REL);
+	data->watchdog.function = ads1015_watchdog_fn;
+	hrtimer_init(&data->sched_timer, CLOCK_MONOTONIC, HRTIMER_MODE_ABS);
+	data->sched_timer.function = ads1015_sched_timer_fn;
+	INIT_WORK(&data->sched_work, ads1015_sched_work);
+	INIT_WORK(&data->notify_work, ads1015_notify_work);
+	INIT_WORK(&data->done_work, ads1015_done_work);
+	INIT_DELAYED_WORK(&data->storm_work, ads1015_storm_work);
+	hrtimer_init(&data->poll_timer, CLOCK_MONOTONIC, HRTIMER_MODE_REL);
+	data->poll_timer.function = ads1015_poll_fn;
+	data->storm_delay_ms = ADS1015_STORM_MIN_DELAY_MS;
 
 	indio_dev->dev.parent = &client->dev;
 	indio_dev->dev.of_node = client->dev.of_node;
 	indio_dev->name = ADS1015_DRV_NAME;
-	indio_dev->modes = (INDIO_BUFFER_SOFTWARE | INDIO_DIRECT_MODE);
+	indio_dev->modes = (INDIO_BUFFER_SOFTWARE | INDIO_BUFFER_TRIGGERED |
+						INDIO_DIRECT_MODE);
 
 	/*
 	 * Tell the core what device type specific functions should
@@ -822,10 +5796,28 @@ static int __attribute__((optimize("O0"))) ads1015_probe(struct i2c_client *clie
 		break;
 	}
 
+	/* the chip converts at its power-on DR until told otherwise */
+	data->edge_period_ns = DIV_ROUND_UP(NSEC_PER_SEC,
+										data->data_rate[ADS1015_DEFAULT_DATA_RATE]);
+
+	/* uV per LSB: full scale over 2^(realbits - 1) */
+	for (k = 0; k < ARRAY_SIZE(data->uv_mult); k++)
+		data->uv_mult[k] = ((u64)ads1015_fullscale_range[k] * 1000 <<
+							ADS1015_UV_MULT_SHIFT) >>
+						   (indio_dev->channels[0].scan_type.realbits - 1);
+
+	/* no correction unless DT or userspace asks for one */
+	for (k = 0; k < ADS1015_CHANNELS; k++)
+		ads1015_set_calibscale(data, k, 1, 0);
+
 	/* we need to keep this ABI the same as used by hwmon ADS1015 driver */
 	ads1015_get_channels_config(client);
 
-	data->regmap = devm_regmap_init_i2c(client, &ads1015_regmap_config);
+	regmap_config = ads1015_regmap_config;
+	regmap_config.lock = ads1015_regmap_lock;
+	regmap_config.unlock = ads1015_regmap_unlock;
+	regmap_config.lock_arg = data;
+	data->regmap = devm_regmap_init_i2c(client, &regmap_config);
 	if (IS_ERR(data->regmap))
 	{
 		dev_err(&client->dev, "Failed to allocate register map\n");
@@ -833,17 +5825,37 @@ static int __attribute__((optimize("O0"))) ads1015_probe(struct i2c_client *clie
 	}
 
 	data->use_buffer = false;
+	data->oneshot_chan = -1;
+	data->cache_max_age_us = ADS1015_CACHE_MAX_AGE_AUTO;
 
-	/* Allocate a buffer to use - here a kfifo */
-	buffer = devm_iio_kfifo_allocate(&client->dev);
+	/* Allocate a buffer to use - a scan ring with an overflow policy */
+	buffer = ads1015_buffer_alloc(indio_dev, data);
 	if (!buffer)
 	{
-		dev_err(&client->dev, "iio kfifo buffer setup failed\n");
+		dev_err(&client->dev, "iio buffer setup failed\n");
 		return -ENOMEM;
 	}
 
 	iio_device_attach_buffer(indio_dev, buffer);
 
+	/* used when current_trigger is set, else the RDY edge paces */
+	indio_dev->pollfunc = iio_alloc_pollfunc(&iio_pollfunc_store_time,
+											 &ads1015_trigger_handler,
+											 IRQF_ONESHOT, indio_dev,
+											 "%s_consumer%d", indio_dev->name,
+											 indio_dev->id);
+	if (!indio_dev->pollfunc)
+		return -ENOMEM;
+
+	ret = devm_add_action_or_reset(&client->dev, ads1015_free_pollfunc,
+								   indio_dev->pollfunc);
+	if (ret)
+		return ret;
+
+	ret = ads1015_probe_streams(indio_dev);
+	if (ret)
+		return ret;
+
 	/* set conversion ready pin */
 	ret = ads1015_set_conv_ready_pin(data);
 	if (ret)
@@ -854,6 +5866,27 @@ static int __attribute__((optimize("O0"))) ads1015_probe(struct i2c_client *clie
 	if (ret)
 		return ret;
 
+	data->irq_priority = ADS1015_IRQ_THREAD_PRIO;
+	cpumask_clear(&data->irq_cpus);
+	data->atomic_batch = ADS1015_DEFAULT_ATOMIC_BATCH;
+	data->ts_ref_interval = ADS1015_DEFAULT_TS_REF_INTERVAL;
+	data->capture.chan = ADS1015_AIN0;
+	data->capture.pre = ADS1015_CAPTURE_DEFAULT_PRE;
+	data->capture.post = ADS1015_CAPTURE_DEFAULT_POST;
+	data->burst.length = ADS1015_BURST_DEFAULT_LENGTH;
+	data->burst.ring = ADS1015_BURST_DEFAULT_RING;
+#ifdef CONFIG_OF
+	ret = ads1015_get_irq_config_of(client);
+	if (ret)
+		return ret;
+#endif
+
+	/* registered before the IRQ so that it is released after it */
+	ret = devm_add_action_or_reset(&client->dev, ads1015_cancel_recovery,
+								   data);
+	if (ret)
+		return ret;
+
 	if (client->irq > 0)
 	{
 		dev_dbg(&client->dev, "irq= %d", client->irq);
@@ -870,6 +5903,33 @@ static int __attribute__((optimize("O0"))) ads1015_probe(struct i2c_client *clie
 		ret = ads1015_probe_irq(indio_dev);
 		if (ret)
 			return ret;
+
+		ret = ads1015_probe_trigger(indio_dev);
+		if (ret)
+		{
+			dev_err(&client->dev, "failed to register trigger\n");
+			return ret;
+		}
+	}
+
+	if (data->atomic_read && (client->irq <= 0 ||
+							  !ads1015_atomic_supported(data)))
+	{
+		dev_warn(&client->dev, "atomic conversion read not supported\n");
+		data->atomic_read = false;
+	}
+
+	if (data->atomic_read)
+	{
+		data->bus_nb.notifier_call = ads1015_bus_notify;
+		ret = bus_register_notifier(&i2c_bus_type, &data->bus_nb);
+		if (ret)
+			return ret;
+
+		ret = devm_add_action_or_reset(&client->dev, ads1015_bus_unwatch,
+									   &data->bus_nb);
+		if (ret)
+			return ret;
 	}
 
 	data->conv_invalid = true;
@@ -882,6 +5942,12 @@ static int __attribute__((optimize("O0"))) ads1015_probe(struct i2c_client *clie
 	pm_runtime_use_autosuspend(&client->dev);
 	pm_runtime_enable(&client->dev);
 
+	/*
+	 * The core copies only the attrs of info->attrs: the binary files go
+	 * with the device groups so they are there by its uevent.
+	 */
+	indio_dev->groups[indio_dev->groupcounter++] = &ads1015_bin_group;
+
 	ret = iio_device_register(indio_dev);
 	if (ret < 0)
 	{
@@ -889,6 +5955,18 @@ static int __attribute__((optimize("O0"))) ads1015_probe(struct i2c_client *clie
 		return ret;
 	}
 
+	for (k = 1; k < ADS1015_STREAMS; k++)
+	{
+		ret = iio_device_register(data->streams[k].indio_dev);
+		if (ret < 0)
+		{
+			dev_err(&client->dev, "Failed to register IIO device\n");
+			ads1015_unregister_streams(data, k);
+			iio_device_unregister(indio_dev);
+			return ret;
+		}
+	}
+
 	return 0;
 }
 
@@ -896,9 +5974,29 @@ static int ads1015_remove(struct i2c_client *client)
 {
 	struct iio_dev *indio_dev = i2c_get_clientdata(client);
 	struct ads1015_data *data = iio_priv(indio_dev);
+	bool stop;
+	int k;
 
+	ads1015_unregister_streams(data, ADS1015_STREAMS);
 	iio_device_unregister(indio_dev);
 
+	mutex_lock(&data->lock);
+	stop = ads1015_capture_stop(data);
+	stop |= ads1015_burst_stop(data);
+	for (k = 0; k < ADS1015_CHANNELS; k++)
+	{
+		if (data->stats[k].window)
+			stop |= ads1015_acq_put(data);
+		if (data->crossing[k].enabled)
+			stop |= ads1015_acq_put(data);
+		data->stats[k].window = 0;
+		data->crossing[k].enabled = false;
+	}
+	mutex_unlock(&data->lock);
+
+	if (stop)
+		ads1015_acq_release(data);
+
 	pm_runtime_disable(&client->dev);
 	pm_runtime_set_suspended(&client->dev);
 	pm_runtime_put_noidle(&client->dev);